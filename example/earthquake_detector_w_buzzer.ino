@@ -1,10 +1,14 @@
 #include <D7S.h>
+#include <D7SAlarm.h>
 #include <LoRa.h>
 
-bool earthquakeState = false; 
-int consecutiveEarthquakeReadings = 0;
-int consecutiveStrongReading = 0;
-const int requiredConsecutiveReadings = 3;
+//earthquake detection (STA/LTA onset on the PGA, sampled every 100 ms, or the D7S state) and alarm decision:
+//the alarm goes on after 1.5 s of consecutive readings of at least 0.05 m/s^2 (15 readings at 100 ms)
+const unsigned long samplePeriod = 100;
+const unsigned long alarmDebounce = 1500;
+D7SAlarm earthquakeAlarm(D7S_ALARM_THRESHOLD, alarmDebounce / samplePeriod);
+const int printEvery = 5;
+int samplesSincePrint = 0;
 
 const int buzzer = 6;
 
@@ -37,76 +41,72 @@ void setup() {
   //INITIALIZATION
   Serial.println("Initializing the D7S sensor");
   delay(2000);
-  Serial.print("Initializing...");
-  D7S.initialize();
-  //wait until the D7S is ready
-  while (!D7S.isReady()) {
-    Serial.print(".");
-    delay(500);
+  Serial.println("Initializing...");
+  //start the initial installation without blocking, loop() polls it
+  D7S.startOperation(D7S_OPERATION_INITIALIZE, D7S_DEFAULT_OPERATION_TIMEOUT, initialized);
+}
+
+//called by pollOperation() when the initial installation is over
+void initialized(d7s_operation operation, d7s_operation_status status, void *ctx) {
+  if (status == D7S_OPERATION_DONE) {
+    Serial.println("INITIALIZED!");
+    Serial.println("\nListening for earthquakes!");
+  } else {
+    Serial.print("Initialization failed: ");
+    Serial.println(status);
   }
-  Serial.println("INITIALIZED!");
-  Serial.println("\nListening for earthquakes!");
 }
 
 void loop() {
+  //wait for the initial installation without blocking the other work of the loop
+  if (D7S.pollOperation() == D7S_OPERATION_RUNNING) {
+    return;
+  }
+
+  //read state, SI and PGA once per loop, everything below works on this sample
+  D7SSnapshot snapshot = D7S.getSnapshot();
+
   /*
   Serial.print("\n\tInstantaneous SI: ");
-  Serial.print(D7S.getInstantaneusSI(), 5);
+  Serial.print(D7S.getInstantaneusPGV(snapshot), 5);
   Serial.println(" [m/s]");
   */
 
-  Serial.print("\n\tInstantaneous PGA: ");
-  Serial.print(D7S.getInstantaneusPGA(), 4);
-  Serial.println(" [m/s^2]");
-
-  Serial.print("\tIntensity Level: ");
-  Serial.println(D7S.getIntensity());
+  //print every 500 ms, the serial port is slower than the sampling
+  if (++samplesSincePrint >= printEvery) {
+    samplesSincePrint = 0;
+    Serial.print("\n\tInstantaneous PGA: ");
+    Serial.print(D7S.getInstantaneusPGA(snapshot), 4);
+    Serial.println(" [m/s^2]");
 
-  //checks if there is an earthquake
-  if (D7S.getInstantaneusPGA() >= 0.01) {
-    consecutiveEarthquakeReadings++;
-    if (consecutiveEarthquakeReadings >= requiredConsecutiveReadings) {
-      earthquakeState = true;
-      consecutiveEarthquakeReadings = 0;
-    }
-  }
-  else{
-    consecutiveEarthquakeReadings = 0;
-    earthquakeState = false;
+    Serial.print("\tIntensity Level: ");
+    Serial.println(D7S.getIntensity(snapshot));
   }
 
-  //checks if the earthquake is strong before setting off the alarm
-  if (earthquakeState) {
+  //checks if there is an earthquake and if it is strong enough to set off the alarm
+  uint8_t decisions = earthquakeAlarm.update(D7S.isEarthquakeOccuring(snapshot), snapshot.pga);
+  if (decisions & D7S_ALARM_DETECTED) {
     Serial.println("An Earthquake has been Detected");
-    if (D7S.getInstantaneusPGA() >= 0.05){
-      consecutiveStrongReading++;
-      unsigned long currentMillis = millis();
-      
-      if (consecutiveStrongReading >= requiredConsecutiveReadings) {
-        if (currentMillis - buzzerPreviousMillis >= buzzerInterval) {
-          //save the last time you toggled the buzzer
-          buzzerPreviousMillis = currentMillis;
-          
-          //if the buzzer is off, turn it on, and vice versa
-          if (digitalRead(buzzer) == LOW) {
-            tone(buzzer, 5); // Adjust frequency as needed
-          } else {
-            noTone(buzzer);
-          }
-        }
+  }
+
+  unsigned long currentMillis = millis();
+  if (earthquakeAlarm.isRaised()) {
+    if (currentMillis - buzzerPreviousMillis >= buzzerInterval) {
+      //save the last time you toggled the buzzer
+      buzzerPreviousMillis = currentMillis;
+
+      //if the buzzer is off, turn it on, and vice versa
+      if (digitalRead(buzzer) == LOW) {
+        tone(buzzer, 5); // Adjust frequency as needed
       } else {
         noTone(buzzer);
-        buzzerPreviousMillis = currentMillis; // Reset the timing
       }
     }
-    else{
-      consecutiveStrongReading = 0;
-      noTone(buzzer);
-    }
   } else {
     noTone(buzzer);
+    buzzerPreviousMillis = currentMillis; // Reset the timing
   }
 
-  //wait 500ms before checking again
-  delay(500);
+  //wait before checking again
+  delay(samplePeriod);
 }
@@ -0,0 +1,125 @@
+//event log storage on a memory-mapped file (Linux), see D7SFileStorage.h
+
+#include "D7SFileStorage.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+D7SFileStorage::D7SFileStorage() {
+   _fd = -1;
+   _map = NULL;
+   _capacity = 0;
+   _mapSize = 0;
+   _readOnly = false;
+}
+
+D7SFileStorage::~D7SFileStorage() {
+   close();
+}
+
+//map the file, creating it erased with capacity bytes if it does not exist (0 = use the size of the file)
+bool D7SFileStorage::open(const char *path, uint32_t capacity, bool readOnly) {
+   close();
+   _readOnly = readOnly;
+   _fd = ::open(path, readOnly ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+   if (_fd < 0) {
+      return false;
+   }
+
+   struct stat info;
+   if (fstat(_fd, &info) != 0) {
+      close();
+      return false;
+   }
+   uint32_t size = (uint32_t) info.st_size;
+   if (size == 0 && capacity == 0) {
+      close();
+      return false;
+   }
+
+   //a new file starts erased, like a blank partition
+   bool created = size == 0;
+   if (created) {
+      if (readOnly || ftruncate(_fd, capacity) != 0) {
+         close();
+         return false;
+      }
+      size = capacity;
+   }
+   _capacity = size - size % D7S_FILE_SECTOR_SIZE;
+   _mapSize = size;
+
+   _map = (uint8_t *) mmap(NULL, size, readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+   if (_map == MAP_FAILED) {
+      _map = NULL;
+      close();
+      return false;
+   }
+   if (created) {
+      memset(_map, 0xFF, size);
+   }
+   return true;
+}
+
+//unmap the file
+void D7SFileStorage::close() {
+   if (_map != NULL) {
+      if (!_readOnly) {
+         msync(_map, _mapSize, MS_SYNC);
+      }
+      munmap(_map, _mapSize);
+      _map = NULL;
+   }
+   if (_fd >= 0) {
+      ::close(_fd);
+      _fd = -1;
+   }
+   _capacity = 0;
+   _mapSize = 0;
+}
+
+//the mapped file, to scan the records in place
+const uint8_t *D7SFileStorage::data() {
+   return _map;
+}
+
+uint32_t D7SFileStorage::capacity() {
+   return _capacity;
+}
+
+uint32_t D7SFileStorage::sectorSize() {
+   return D7S_FILE_SECTOR_SIZE;
+}
+
+bool D7SFileStorage::read(uint32_t offset, uint8_t *data, uint32_t len) {
+   if (_map == NULL || offset + len > _capacity) {
+      return false;
+   }
+   memcpy(data, _map + offset, len);
+   return true;
+}
+
+//like flash, a write can only clear bits
+bool D7SFileStorage::write(uint32_t offset, const uint8_t *data, uint32_t len) {
+   if (_map == NULL || _readOnly || offset + len > _capacity) {
+      return false;
+   }
+   for (uint32_t i = 0; i < len; i++) {
+      _map[offset + i] &= data[i];
+   }
+   return true;
+}
+
+bool D7SFileStorage::erase(uint32_t offset) {
+   if (_map == NULL || _readOnly || offset % D7S_FILE_SECTOR_SIZE || offset >= _capacity) {
+      return false;
+   }
+   memset(_map + offset, 0xFF, D7S_FILE_SECTOR_SIZE);
+   return true;
+}
+
+bool D7SFileStorage::sync() {
+   return _map != NULL && (_readOnly || msync(_map, _capacity, MS_ASYNC) == 0);
+}
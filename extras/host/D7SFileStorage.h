@@ -0,0 +1,39 @@
+#ifndef D7S_FILE_STORAGE_H
+#define D7S_FILE_STORAGE_H
+
+#include "D7SEventLog.h"
+
+//--- FILE STORAGE DEFAULTS ---
+#define D7S_FILE_SECTOR_SIZE 4096 //erase unit emulated on the file (same as the ESP32 flash) [byte]
+
+//event log storage on a plain file, memory-mapped (Linux)
+//the file has the same layout as the flash partition, so a partition dump can be opened and queried offline;
+//reads and writes are memcpy on the mapping, the kernel writes the pages back (sync() forces it)
+class D7SFileStorage : public D7SLogStorage {
+
+   public:
+
+      D7SFileStorage();
+      ~D7SFileStorage();
+
+      bool open(const char *path, uint32_t capacity = 0, bool readOnly = false); //map the file, creating it erased with capacity bytes if it does not exist (0 = use the size of the file)
+      void close(); //unmap the file
+      const uint8_t *data(); //the mapped file, to scan the records in place
+
+      uint32_t capacity();
+      uint32_t sectorSize();
+      bool read(uint32_t offset, uint8_t *data, uint32_t len);
+      bool write(uint32_t offset, const uint8_t *data, uint32_t len);
+      bool erase(uint32_t offset);
+      bool sync();
+
+   private:
+
+      int _fd;
+      uint8_t *_map;
+      uint32_t _capacity;
+      uint32_t _mapSize; //size of the file
+      bool _readOnly;
+};
+
+#endif
@@ -0,0 +1,129 @@
+//Arduino functions used by the library, for host (Linux) builds
+//the clock is virtual and the pins are simulated, see D7SPlatform.h
+
+#if !defined(ARDUINO)
+
+#include "D7SPlatform.h"
+
+//--- TIME ---
+//virtual clock [us]
+static uint64_t hostTime = 0;
+
+uint32_t millis() {
+   return (uint32_t) (hostTime / 1000);
+}
+
+uint32_t micros() {
+   return (uint32_t) hostTime;
+}
+
+void delay(uint32_t ms) {
+   hostTime += ((uint64_t) ms) * 1000;
+}
+
+void delayMicroseconds(uint32_t us) {
+   hostTime += us;
+}
+
+//move the virtual clock forward [us]
+void d7sHostAdvance(uint32_t us) {
+   hostTime += us;
+}
+
+//--- PINS/INTERRUPTS ---
+#define HOST_PINS 64
+
+//simulated pin
+struct HostPin {
+   uint8_t level;
+   void (*isr)();
+   void (*isrArg)(void *);
+   void *arg;
+   int mode;
+};
+
+//all the pins start HIGH (the d7s interrupt lines are open drain with pull up)
+static HostPin hostPins[HOST_PINS];
+static bool hostPinsReady = false;
+
+//set the initial state of the pins
+static void initPins() {
+   if (hostPinsReady) {
+      return;
+   }
+   for (int i = 0; i < HOST_PINS; i++) {
+      hostPins[i].level = HIGH;
+      hostPins[i].isr = NULL;
+      hostPins[i].isrArg = NULL;
+      hostPins[i].arg = NULL;
+      hostPins[i].mode = 0;
+   }
+   hostPinsReady = true;
+}
+
+//the pull up is always there on the simulated pins
+void pinMode(uint8_t pin, uint8_t mode) {
+   (void) pin;
+   (void) mode;
+   initPins();
+}
+
+int digitalRead(uint8_t pin) {
+   initPins();
+   return pin < HOST_PINS ? hostPins[pin].level : LOW;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+   initPins();
+   if (interrupt < HOST_PINS) {
+      hostPins[interrupt].isr = isr;
+      hostPins[interrupt].isrArg = NULL;
+      hostPins[interrupt].mode = mode;
+   }
+}
+
+void attachInterruptArg(uint8_t interrupt, void (*isr)(void *), void *arg, int mode) {
+   initPins();
+   if (interrupt < HOST_PINS) {
+      hostPins[interrupt].isr = NULL;
+      hostPins[interrupt].isrArg = isr;
+      hostPins[interrupt].arg = arg;
+      hostPins[interrupt].mode = mode;
+   }
+}
+
+void detachInterrupt(uint8_t interrupt) {
+   initPins();
+   if (interrupt < HOST_PINS) {
+      hostPins[interrupt].isr = NULL;
+      hostPins[interrupt].isrArg = NULL;
+   }
+}
+
+//there is no real interrupt on the host, the isr runs synchronously inside d7sHostSetPin()
+void interrupts() {
+}
+
+void noInterrupts() {
+}
+
+//drive a simulated pin, calling the attached isr on a matching edge
+void d7sHostSetPin(uint8_t pin, uint8_t level) {
+   initPins();
+   if (pin >= HOST_PINS || hostPins[pin].level == level) {
+      return;
+   }
+   hostPins[pin].level = level;
+   //check if the edge matches the mode of the attached isr
+   int edge = level == HIGH ? RISING : FALLING;
+   if (hostPins[pin].mode != CHANGE && hostPins[pin].mode != edge) {
+      return;
+   }
+   if (hostPins[pin].isr != NULL) {
+      hostPins[pin].isr();
+   } else if (hostPins[pin].isrArg != NULL) {
+      hostPins[pin].isrArg(hostPins[pin].arg);
+   }
+}
+
+#endif
@@ -0,0 +1,441 @@
+#include "D7SSimulator.h"
+#include "D7S.h"
+
+//the d7s holds the last earthquakes in 0x3000-0x3400 (latest, 0x30 is the newest) and 0x3500-0x3900 (ranked by SI)
+#define SIM_LATEST 0x30
+#define SIM_RANKED 0x35
+#define SIM_RECORDS 5
+
+//register addresses
+#define SIM_STATE 0x1000
+#define SIM_AXIS_STATE 0x1001
+#define SIM_EVENT 0x1002
+#define SIM_MODE 0x1003
+#define SIM_CTRL 0x1004
+#define SIM_CLEAR_COMMAND 0x1005
+#define SIM_MAIN_SI 0x2000
+#define SIM_MAIN_PGA 0x2002
+
+//power-on value of CTRL used by the simulator (switch axis at installation, threshold high)
+#define SIM_CTRL_DEFAULT 0x40
+
+//true if time a is at or after time b (wrap-around safe)
+static bool reached(uint32_t a, uint32_t b) {
+   return (int32_t) (a - b) >= 0;
+}
+
+D7SSimulator::D7SSimulator() {
+   memset(_registers, 0, sizeof(_registers));
+   _registers[SIM_CTRL] = SIM_CTRL_DEFAULT;
+   _pointer = 0;
+
+   _clock = D7S_I2C_STANDARD_MODE;
+   _transfers = 0;
+   _busTime = 0;
+   _nackCount = 0;
+   _nackStatus = 2;
+   _connected = true;
+
+   _pinINT1 = 0xFF;
+   _pinINT2 = 0xFF;
+
+   _waveform = NULL;
+   _waveformCount = 0;
+   _waveformStart = 0;
+   _steadySI = 0;
+   _steadyPGA = 0;
+   _startThreshold = D7S_SIM_START_THRESHOLD;
+
+   _mode = NORMAL_MODE;
+   _modeEnd = 0;
+   _selftestError = false;
+   _temperature = 250;
+
+   _inEarthquake = false;
+   _eventStart = 0;
+   _quietSince = 0;
+   _peakSI = 0;
+   _peakPGA = 0;
+   _shutoffRaised = false;
+}
+
+//--- TRANSPORT ---
+
+void D7SSimulator::begin() {
+}
+
+void D7SSimulator::setClock(uint32_t clock) {
+   _clock = clock;
+}
+
+void D7SSimulator::setTimeout(uint16_t timeout) {
+   (void) timeout;
+}
+
+uint8_t D7SSimulator::write(uint8_t address, const uint8_t *data, uint8_t len, bool stop) {
+   (void) stop;
+   _transfers++;
+   wireTime(len + 1);
+   update();
+
+   //nobody answers on this address
+   if (address != D7S_ADDRESS || !_connected) {
+      return 2;
+   }
+   if (fault()) {
+      return _nackStatus;
+   }
+   //the first two bytes are the register address
+   if (len < 2) {
+      return 3;
+   }
+   _pointer = (data[0] << 8) | data[1];
+
+   //the following bytes are written from the register address on
+   for (uint8_t i = 2; i < len; i++) {
+      uint16_t reg = _pointer++;
+      uint8_t value = data[i];
+      switch (reg) {
+         case SIM_MODE:
+            startMode(value);
+            break;
+         case SIM_CTRL:
+            _registers[reg] = value;
+            //a forced axis is used right away
+            if ((value >> 4) <= FORXE_XY) {
+               _registers[SIM_AXIS_STATE] = value >> 4;
+            }
+            break;
+         case SIM_CLEAR_COMMAND:
+            clear(value);
+            break;
+         default:
+            //the other registers are read only
+            break;
+      }
+   }
+   return 0;
+}
+
+uint8_t D7SSimulator::read(uint8_t address, uint8_t *data, uint8_t len) {
+   _transfers++;
+   wireTime(len + 1);
+   update();
+
+   //nobody answers on this address
+   if (address != D7S_ADDRESS || !_connected || fault()) {
+      return 0;
+   }
+
+   bool eventRead = false;
+   for (uint8_t i = 0; i < len; i++) {
+      if (_pointer == SIM_EVENT) {
+         eventRead = true;
+      }
+      data[i] = _registers[_pointer++];
+   }
+
+   //reading EVENT clears the shutoff/collapse bits and releases INT1
+   if (eventRead) {
+      _registers[SIM_EVENT] &= ~0x03;
+      setInt1(HIGH);
+   }
+   return len;
+}
+
+//--- SCENARIO ---
+
+//pins driven by INT1/INT2 (0xFF = not connected)
+void D7SSimulator::setInterruptPins(uint8_t pinINT1, uint8_t pinINT2) {
+   _pinINT1 = pinINT1;
+   _pinINT2 = pinINT2;
+}
+
+//PGA that starts the earthquake processing [mm/s^2]
+void D7SSimulator::setStartThreshold(uint16_t pga) {
+   _startThreshold = pga;
+}
+
+//shaking when no waveform is playing
+void D7SSimulator::setInstantaneous(uint16_t si, uint16_t pga) {
+   _steadySI = si;
+   _steadyPGA = pga;
+}
+
+//play a waveform starting now (the samples are not copied)
+void D7SSimulator::playWaveform(const D7SSimSample *samples, uint32_t count) {
+   _waveform = samples;
+   _waveformCount = count;
+   _waveformStart = millis();
+}
+
+//return true while the waveform is playing
+uint8_t D7SSimulator::isPlaying() {
+   return _waveform != NULL && _waveformCount > 0 && millis() - _waveformStart <= _waveform[_waveformCount - 1].time;
+}
+
+//make the next count transfers fail with status
+void D7SSimulator::injectNack(uint16_t count, uint8_t status) {
+   _nackCount = count;
+   _nackStatus = status;
+}
+
+//simulate an unplugged sensor (every transfer is NACKed)
+void D7SSimulator::setConnected(bool connected) {
+   _connected = connected;
+}
+
+//raise the collapse event (INT1)
+void D7SSimulator::injectCollapse() {
+   _registers[SIM_EVENT] |= 0x02;
+   setInt1(LOW);
+}
+
+//result of the next selftest/offset acquisition
+void D7SSimulator::setSelftestError(bool error) {
+   _selftestError = error;
+}
+
+//temperature stored in the records [0.1 C]
+void D7SSimulator::setTemperature(int16_t temperature) {
+   _temperature = temperature;
+}
+
+//advance the model to the current time
+void D7SSimulator::update() {
+   uint32_t now = millis();
+
+   //end of initial installation, offset acquisition or selftest
+   if (_mode != NORMAL_MODE) {
+      if (!reached(now, _modeEnd)) {
+         return;
+      }
+      //result bits of the EVENT register (bit 2 = selftest error, bit 3 = offset acquisition error)
+      if (_mode == SELFTEST_MODE) {
+         _registers[SIM_EVENT] = (_registers[SIM_EVENT] & ~0x04) | (_selftestError ? 0x04 : 0x00);
+      } else if (_mode == OFFSET_ACQUISITION_MODE) {
+         _registers[SIM_EVENT] = (_registers[SIM_EVENT] & ~0x08) | (_selftestError ? 0x08 : 0x00);
+      }
+      _mode = NORMAL_MODE;
+      _registers[SIM_STATE] = NORMAL_MODE;
+      setInt2(HIGH);
+   }
+
+   uint16_t si, pga;
+   currentShaking(si, pga);
+
+   //the processing starts when the acceleration passes the threshold
+   if (!_inEarthquake) {
+      if (pga < _startThreshold) {
+         return;
+      }
+      startEarthquake();
+   }
+
+   //instantaneous data
+   setReg16(SIM_MAIN_SI, si);
+   setReg16(SIM_MAIN_PGA, pga);
+   if (si > _peakSI) {
+      _peakSI = si;
+   }
+   if (pga > _peakPGA) {
+      _peakPGA = pga;
+   }
+
+   //shutoff judgment (once per earthquake)
+   if (!_shutoffRaised && si >= D7S_SIM_SHUTOFF_SI) {
+      _shutoffRaised = true;
+      _registers[SIM_EVENT] |= 0x01;
+      setInt1(LOW);
+   }
+
+   //end of the processing
+   if (pga >= _startThreshold) {
+      _quietSince = now;
+   }
+   if (now - _quietSince >= D7S_SIM_END_HOLD || now - _eventStart >= D7S_SIM_MAX_EVENT) {
+      endEarthquake();
+   }
+}
+
+//--- INSPECTION ---
+
+//read a register without side effects
+uint8_t D7SSimulator::peek(uint16_t reg) {
+   return _registers[reg];
+}
+
+//write a register without side effects
+void D7SSimulator::poke(uint16_t reg, uint8_t value) {
+   _registers[reg] = value;
+}
+
+//number of transfers seen
+uint32_t D7SSimulator::getTransfers() {
+   return _transfers;
+}
+
+//time spent on the wire [us]
+uint32_t D7SSimulator::getBusTime() {
+   return _busTime;
+}
+
+//--- MODEL ---
+
+//advance the clock by the time bytes take on the wire (9 clocks per byte plus start/stop)
+void D7SSimulator::wireTime(uint8_t bytes) {
+   uint32_t time = (((uint32_t) bytes) * 9 + 2) * 1000000 / _clock;
+   _busTime += time;
+   d7sHostAdvance(time);
+}
+
+//consume an injected fault, true if the transfer must fail
+bool D7SSimulator::fault() {
+   if (_nackCount == 0) {
+      return false;
+   }
+   _nackCount--;
+   return true;
+}
+
+//shaking at the current time (the waveform is held between samples)
+void D7SSimulator::currentShaking(uint16_t &si, uint16_t &pga) {
+   si = _steadySI;
+   pga = _steadyPGA;
+   if (_waveform == NULL || _waveformCount == 0) {
+      return;
+   }
+   uint32_t t = millis() - _waveformStart;
+   //past the end, the waveform is done
+   if (t > _waveform[_waveformCount - 1].time) {
+      _waveform = NULL;
+      return;
+   }
+   //binary search of the last sample at or before t
+   uint32_t low = 0, high = _waveformCount;
+   while (high - low > 1) {
+      uint32_t mid = (low + high) / 2;
+      if (_waveform[mid].time <= t) {
+         low = mid;
+      } else {
+         high = mid;
+      }
+   }
+   if (_waveform[low].time <= t) {
+      si = _waveform[low].si;
+      pga = _waveform[low].pga;
+   }
+}
+
+//enter initial installation, offset acquisition or selftest
+void D7SSimulator::startMode(uint8_t mode) {
+   if (mode != INITIAL_INSTALLATION_MODE && mode != OFFSET_ACQUISITION_MODE && mode != SELFTEST_MODE) {
+      return;
+   }
+   //a mode command ends the earthquake processing
+   _inEarthquake = false;
+   _mode = mode;
+   _modeEnd = millis() + D7S_SIM_MODE_DURATION;
+   _registers[SIM_STATE] = mode;
+   setInt2(LOW);
+}
+
+//execute CLEAR_COMMAND
+void D7SSimulator::clear(uint8_t command) {
+   //earthquake data (latest and ranked)
+   if (command & 0x01) {
+      for (uint8_t regH = SIM_LATEST; regH < SIM_RANKED + SIM_RECORDS; regH++) {
+         memset(&_registers[regH << 8], 0, D7S_RECORD_SIZE);
+      }
+   }
+   //selftest data
+   if (command & 0x02) {
+      _registers[SIM_EVENT] &= ~0x04;
+   }
+   //offset data
+   if (command & 0x04) {
+      _registers[SIM_EVENT] &= ~0x08;
+   }
+}
+
+void D7SSimulator::startEarthquake() {
+   uint32_t now = millis();
+   _inEarthquake = true;
+   _eventStart = now;
+   _quietSince = now;
+   _peakSI = 0;
+   _peakPGA = 0;
+   _shutoffRaised = false;
+   _registers[SIM_STATE] = NORMAL_MODE_NOT_IN_STANBY;
+   setInt2(LOW);
+}
+
+void D7SSimulator::endEarthquake() {
+   _inEarthquake = false;
+   storeRecord();
+   _registers[SIM_STATE] = NORMAL_MODE;
+   setInt2(HIGH);
+}
+
+//store the earthquake in the latest and ranked records
+void D7SSimulator::storeRecord() {
+   uint8_t record[D7S_RECORD_SIZE];
+   uint8_t other[D7S_RECORD_SIZE];
+
+   //offsets are not modelled (0), then temperature, SI and PGA (msb first)
+   memset(record, 0, sizeof(record));
+   record[6] = (uint16_t) _temperature >> 8;
+   record[7] = (uint16_t) _temperature & 0xFF;
+   record[8] = _peakSI >> 8;
+   record[9] = _peakSI & 0xFF;
+   record[10] = _peakPGA >> 8;
+   record[11] = _peakPGA & 0xFF;
+
+   //latest: shift the older ones down, the newest is at 0x30
+   for (uint8_t slot = SIM_RECORDS - 1; slot > 0; slot--) {
+      readRecord(SIM_LATEST + slot - 1, other);
+      writeRecord(SIM_LATEST + slot, other);
+   }
+   writeRecord(SIM_LATEST, record);
+
+   //ranked: insert by SI, the weaker ones move down
+   for (uint8_t slot = 0; slot < SIM_RECORDS; slot++) {
+      if (_peakSI > reg16(((SIM_RANKED + slot) << 8) | 0x08)) {
+         for (uint8_t move = SIM_RECORDS - 1; move > slot; move--) {
+            readRecord(SIM_RANKED + move - 1, other);
+            writeRecord(SIM_RANKED + move, other);
+         }
+         writeRecord(SIM_RANKED + slot, record);
+         break;
+      }
+   }
+}
+
+void D7SSimulator::writeRecord(uint8_t regH, const uint8_t *record) {
+   memcpy(&_registers[regH << 8], record, D7S_RECORD_SIZE);
+}
+
+void D7SSimulator::readRecord(uint8_t regH, uint8_t *record) {
+   memcpy(record, &_registers[regH << 8], D7S_RECORD_SIZE);
+}
+
+void D7SSimulator::setInt1(uint8_t level) {
+   if (_pinINT1 != 0xFF) {
+      d7sHostSetPin(_pinINT1, level);
+   }
+}
+
+void D7SSimulator::setInt2(uint8_t level) {
+   if (_pinINT2 != 0xFF) {
+      d7sHostSetPin(_pinINT2, level);
+   }
+}
+
+uint16_t D7SSimulator::reg16(uint16_t reg) {
+   return (_registers[reg] << 8) | _registers[(uint16_t) (reg + 1)];
+}
+
+void D7SSimulator::setReg16(uint16_t reg, uint16_t value) {
+   _registers[reg] = value >> 8;
+   _registers[(uint16_t) (reg + 1)] = value & 0xFF;
+}
@@ -0,0 +1,113 @@
+#ifndef D7S_SIMULATOR_H
+#define D7S_SIMULATOR_H
+
+#include "D7STransport.h"
+
+//--- SIMULATOR DEFAULTS ---
+#define D7S_SIM_MODE_DURATION 2000 //time spent in initial installation, offset acquisition and selftest [ms]
+#define D7S_SIM_START_THRESHOLD 10 //PGA that starts the earthquake processing [mm/s^2]
+#define D7S_SIM_END_HOLD 1000 //time the PGA must stay under the start threshold to end the earthquake [ms]
+#define D7S_SIM_MAX_EVENT 120000 //the d7s ends the processing after at most 2 minutes [ms]
+#define D7S_SIM_SHUTOFF_SI 50 //SI that raises the shutoff event (5 kine) [mm/s]
+
+//sample of a simulated waveform
+struct D7SSimSample {
+   uint32_t time; //time from the start of the waveform [ms]
+   uint16_t si; //instantaneous SI [mm/s]
+   uint16_t pga; //instantaneous PGA [mm/s^2]
+};
+
+//host-side model of the d7s register map, used as transport of a D7SClass
+//it models STATE, AXIS_STATE, EVENT (cleared on read), MODE, CTRL, CLEAR_COMMAND, the instantaneous data at 0x20xx
+//and the latest/ranked records at 0x30xx-0x39xx, drives INT1/INT2 and can inject waveforms and bus faults
+//the model moves with the virtual clock of the host platform, every transfer advances it by the time the bytes take on the wire
+class D7SSimulator : public D7STransport {
+
+   public:
+
+      D7SSimulator();
+
+      //--- TRANSPORT ---
+      void begin();
+      void setClock(uint32_t clock);
+      void setTimeout(uint16_t timeout);
+      uint8_t write(uint8_t address, const uint8_t *data, uint8_t len, bool stop);
+      uint8_t read(uint8_t address, uint8_t *data, uint8_t len);
+
+      //--- SCENARIO ---
+      void setInterruptPins(uint8_t pinINT1, uint8_t pinINT2); //pins driven by INT1/INT2 (0xFF = not connected)
+      void setStartThreshold(uint16_t pga); //PGA that starts the earthquake processing [mm/s^2]
+      void setInstantaneous(uint16_t si, uint16_t pga); //shaking when no waveform is playing
+      void playWaveform(const D7SSimSample *samples, uint32_t count); //play a waveform starting now (the samples are not copied)
+      uint8_t isPlaying(); //return true while the waveform is playing
+      void injectNack(uint16_t count, uint8_t status = 2); //make the next count transfers fail with status
+      void setConnected(bool connected); //simulate an unplugged sensor (every transfer is NACKed)
+      void injectCollapse(); //raise the collapse event (INT1)
+      void setSelftestError(bool error); //result of the next selftest/offset acquisition
+      void setTemperature(int16_t temperature); //temperature stored in the records [0.1 C]
+      void update(); //advance the model to the current time (called by every transfer, call it while idle to get the INT edges)
+
+      //--- INSPECTION ---
+      uint8_t peek(uint16_t reg); //read a register without side effects
+      void poke(uint16_t reg, uint8_t value); //write a register without side effects
+      uint32_t getTransfers(); //number of transfers seen
+      uint32_t getBusTime(); //time spent on the wire [us]
+
+   private:
+
+      //register map (indexed by the 16 bit address)
+      uint8_t _registers[0x10000];
+      uint16_t _pointer; //register address pointer (auto-incremented by reads)
+
+      //bus
+      uint32_t _clock;
+      uint32_t _transfers;
+      uint32_t _busTime;
+      uint16_t _nackCount;
+      uint8_t _nackStatus;
+      bool _connected;
+
+      //interrupt pins
+      uint8_t _pinINT1;
+      uint8_t _pinINT2;
+
+      //shaking
+      const D7SSimSample *_waveform;
+      uint32_t _waveformCount;
+      uint32_t _waveformStart;
+      uint16_t _steadySI;
+      uint16_t _steadyPGA;
+      uint16_t _startThreshold;
+
+      //mode in progress (initial installation, offset acquisition, selftest)
+      uint8_t _mode;
+      uint32_t _modeEnd;
+      bool _selftestError;
+      int16_t _temperature;
+
+      //earthquake in progress
+      bool _inEarthquake;
+      uint32_t _eventStart;
+      uint32_t _quietSince;
+      uint16_t _peakSI;
+      uint16_t _peakPGA;
+      bool _shutoffRaised;
+
+      //--- MODEL ---
+      void wireTime(uint8_t bytes); //advance the clock by the time bytes take on the wire
+      bool fault(); //consume an injected fault, true if the transfer must fail
+      void currentShaking(uint16_t &si, uint16_t &pga); //shaking at the current time
+      void startMode(uint8_t mode); //enter initial installation, offset acquisition or selftest
+      void clear(uint8_t command); //execute CLEAR_COMMAND
+      void startEarthquake();
+      void endEarthquake();
+      void storeRecord(); //store the earthquake in the latest and ranked records
+      void writeRecord(uint8_t regH, const uint8_t *record);
+      void readRecord(uint8_t regH, uint8_t *record);
+      void setInt1(uint8_t level);
+      void setInt2(uint8_t level);
+      uint16_t reg16(uint16_t reg);
+      void setReg16(uint16_t reg, uint16_t value);
+};
+
+#endif
@@ -0,0 +1,141 @@
+//bus cost of every public method of D7SClass, measured on the simulated d7s with the built-in bus statistics
+//build from the library root:
+//   g++ -std=c++11 -O2 -Isrc -Iextras/host src/*.cpp extras/host/D7SHostPlatform.cpp extras/host/D7SSimulator.cpp extras/host/bench/d7s_bench.cpp -o d7s_bench
+//usage: d7s_bench [iterations]
+//
+//for every method it prints:
+//   host calls/s     calls per second of host CPU (library overhead, the simulated wire time is virtual)
+//   tx/call          register accesses per call
+//   bytes/call       bytes on the wire per call
+//   bus us/call      time blocked on the bus per call at the given clock
+//   bus calls/s      calls per second the bus allows (1e6 / bus us/call), what the sensor can sustain on a device
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "D7S.h"
+#include "D7SSimulator.h"
+
+#define PIN_INT1 2
+#define PIN_INT2 3
+
+//method under test
+struct Benchmark {
+   const char *name;
+   d7s_api api;
+   void (*run)(D7SClass &d7s, D7SSimulator &simulator);
+};
+
+static volatile uint32_t sink;
+
+static void benchGetState(D7SClass &d7s, D7SSimulator &) { sink += d7s.getState(); }
+static void benchGetAxisInUse(D7SClass &d7s, D7SSimulator &) { sink += d7s.getAxisInUse(); }
+static void benchSetThreshold(D7SClass &d7s, D7SSimulator &) { d7s.setThreshold(THRESHOLD_HIGH); }
+static void benchSetAxis(D7SClass &d7s, D7SSimulator &) { d7s.setAxis(AUTO_SWITCH); }
+static void benchGetLastestPGV(D7SClass &d7s, D7SSimulator &) { sink += (uint32_t) d7s.getLastestPGV(0); }
+static void benchGetLastestPGA(D7SClass &d7s, D7SSimulator &) { sink += (uint32_t) d7s.getLastestPGA(0); }
+static void benchGetLastestTemperature(D7SClass &d7s, D7SSimulator &) { sink += (uint32_t) d7s.getLastestTemperatureRaw(0); }
+static void benchGetLatestRecord(D7SClass &d7s, D7SSimulator &) { sink += d7s.getLatestRecord(0).si; }
+static void benchGetRankedRecord(D7SClass &d7s, D7SSimulator &) { sink += d7s.getRankedRecord(0).si; }
+static void benchGetInstantaneusPGV(D7SClass &d7s, D7SSimulator &) { sink += (uint32_t) d7s.getInstantaneusPGV(); }
+static void benchGetInstantaneusPGA(D7SClass &d7s, D7SSimulator &) { sink += (uint32_t) d7s.getInstantaneusPGA(); }
+static void benchGetIntensity(D7SClass &d7s, D7SSimulator &) { sink += d7s.getIntensity(); }
+static void benchGetSnapshot(D7SClass &d7s, D7SSimulator &) { sink += d7s.getSnapshot().pga; }
+static void benchGetSelftestResult(D7SClass &d7s, D7SSimulator &) { sink += d7s.getSelftestResult(); }
+static void benchGetAcquireOffsetResult(D7SClass &d7s, D7SSimulator &) { sink += d7s.getAcquireOffsetResult(); }
+static void benchIsInCollapse(D7SClass &d7s, D7SSimulator &) { sink += d7s.isInCollapse(); }
+static void benchIsInShutoff(D7SClass &d7s, D7SSimulator &) { sink += d7s.isInShutoff(); }
+static void benchResetEvents(D7SClass &d7s, D7SSimulator &) { d7s.resetEvents(); }
+static void benchIsEarthquakeOccuring(D7SClass &d7s, D7SSimulator &) { sink += d7s.isEarthquakeOccuring(); }
+static void benchIsReady(D7SClass &d7s, D7SSimulator &) { sink += d7s.isReady(); }
+static void benchAcquireSample(D7SClass &d7s, D7SSimulator &) { sink += d7s.acquireSample().pga; }
+static void benchReadHistory(D7SClass &d7s, D7SSimulator &) { D7SHistory history = {}; sink += d7s.readHistory(history); }
+static void benchClearEarthquakeData(D7SClass &d7s, D7SSimulator &) { d7s.clearEarthquakeData(); }
+
+//one collapse interrupt (INT1) per call
+static void benchProcessEvents(D7SClass &d7s, D7SSimulator &simulator) {
+   simulator.injectCollapse();
+   sink += d7s.processEvents();
+}
+
+//incremental history sync when nothing changed (the common case after a reboot)
+static void benchUpdateHistory(D7SClass &d7s, D7SSimulator &) {
+   static D7SHistory history = {};
+   sink += d7s.updateHistory(history);
+}
+
+//a snapshot with one NACK on every call
+static void benchGetSnapshotNack(D7SClass &d7s, D7SSimulator &simulator) {
+   simulator.injectNack(1);
+   sink += d7s.getSnapshot().pga;
+}
+
+static const Benchmark benchmarks[] = {
+   {"getState", D7S_API_GET_STATE, benchGetState},
+   {"getAxisInUse", D7S_API_GET_AXIS_IN_USE, benchGetAxisInUse},
+   {"setThreshold", D7S_API_SET_THRESHOLD, benchSetThreshold},
+   {"setAxis", D7S_API_SET_AXIS, benchSetAxis},
+   {"getLastestPGV", D7S_API_GET_LASTEST_PGV, benchGetLastestPGV},
+   {"getLastestPGA", D7S_API_GET_LASTEST_PGA, benchGetLastestPGA},
+   {"getLastestTemperature", D7S_API_GET_LASTEST_TEMPERATURE, benchGetLastestTemperature},
+   {"getLatestRecord", D7S_API_GET_LATEST_RECORD, benchGetLatestRecord},
+   {"getRankedRecord", D7S_API_GET_RANKED_RECORD, benchGetRankedRecord},
+   {"getInstantaneusPGV", D7S_API_GET_INSTANTANEUS_PGV, benchGetInstantaneusPGV},
+   {"getInstantaneusPGA", D7S_API_GET_INSTANTANEUS_PGA, benchGetInstantaneusPGA},
+   {"getIntensity", D7S_API_GET_INTENSITY, benchGetIntensity},
+   {"getSnapshot", D7S_API_GET_SNAPSHOT, benchGetSnapshot},
+   {"getSelftestResult", D7S_API_GET_SELFTEST_RESULT, benchGetSelftestResult},
+   {"getAcquireOffsetResult", D7S_API_GET_ACQUIRE_OFFSET_RESULT, benchGetAcquireOffsetResult},
+   {"isInCollapse", D7S_API_IS_IN_COLLAPSE, benchIsInCollapse},
+   {"isInShutoff", D7S_API_IS_IN_SHUTOFF, benchIsInShutoff},
+   {"resetEvents", D7S_API_RESET_EVENTS, benchResetEvents},
+   {"isEarthquakeOccuring", D7S_API_IS_EARTHQUAKE_OCCURING, benchIsEarthquakeOccuring},
+   {"isReady", D7S_API_IS_READY, benchIsReady},
+   {"acquireSample", D7S_API_ACQUIRE_SAMPLE, benchAcquireSample},
+   {"readHistory", D7S_API_READ_HISTORY, benchReadHistory},
+   {"updateHistory", D7S_API_UPDATE_HISTORY, benchUpdateHistory},
+   {"clearEarthquakeData", D7S_API_CLEAR, benchClearEarthquakeData},
+   {"processEvents (INT1)", D7S_API_PROCESS_EVENTS, benchProcessEvents},
+   {"getSnapshot (1 NACK)", D7S_API_GET_SNAPSHOT, benchGetSnapshotNack},
+};
+
+//run every benchmark at the given bus clock
+static void runAll(uint32_t clock, uint32_t iterations) {
+   printf("\nbus clock %u Hz, %u iterations\n", (unsigned) clock, (unsigned) iterations);
+   printf("%-24s %14s %8s %10s %12s %12s %8s\n", "method", "host calls/s", "tx/call", "bytes/call", "bus us/call", "bus calls/s", "retries");
+
+   for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+      const Benchmark &benchmark = benchmarks[i];
+      D7SSimulator simulator;
+      D7SClass d7s(simulator);
+      D7SBusStats stats;
+
+      //same setup for every method: interrupts connected and handled
+      simulator.setInterruptPins(PIN_INT1, PIN_INT2);
+      d7s.begin(clock);
+      d7s.enableInterruptINT1(PIN_INT1);
+      d7s.enableInterruptINT2(PIN_INT2);
+      d7s.startInterruptHandling();
+      d7s.resetBusStats();
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (uint32_t n = 0; n < iterations; n++) {
+         benchmark.run(d7s, simulator);
+      }
+      double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      d7s.getBusStats(stats);
+      const D7SBusCounters &counters = stats.api[benchmark.api];
+      double calls = counters.calls ? counters.calls : 1;
+      double busPerCall = counters.busTime / calls;
+      printf("%-24s %14.0f %8.2f %10.1f %12.1f %12.1f %8u\n", benchmark.name, iterations / elapsed, counters.transactions / calls, counters.bytes / calls, busPerCall, busPerCall > 0 ? 1e6 / busPerCall : 0.0, (unsigned) counters.retries);
+   }
+}
+
+int main(int argc, char **argv) {
+   uint32_t iterations = argc > 1 ? (uint32_t) atoi(argv[1]) : 20000;
+   runAll(D7S_I2C_STANDARD_MODE, iterations);
+   runAll(D7S_I2C_FAST_MODE, iterations);
+   return 0;
+}
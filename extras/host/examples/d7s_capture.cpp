@@ -0,0 +1,76 @@
+//capture an earthquake with pre-trigger history on the simulated d7s and print its time history
+//build from the library root:
+//   g++ -std=c++11 -O2 -Isrc -Iextras/host src/*.cpp extras/host/D7SHostPlatform.cpp extras/host/D7SSimulator.cpp extras/host/examples/d7s_capture.cpp -o d7s_capture
+
+#include <stdio.h>
+
+#include "D7S.h"
+#include "D7SSimulator.h"
+
+#define PIN_INT1 2
+#define PIN_INT2 3
+
+#define IDLE_PERIOD 200 //sampling period while nothing happens [ms]
+
+static D7SSimulator simulator;
+static D7SClass d7s(simulator);
+static D7SCapture capture;
+
+//a 3 s earthquake sampled every 50 ms: ramp up to 0.8 m/s^2, then decay
+//at the fastest capture period (10 ms) it fits the buffer after the pre-trigger samples
+#define WAVEFORM_SAMPLES 60
+static D7SSimSample waveform[WAVEFORM_SAMPLES];
+
+int main() {
+   //build the waveform
+   for (int i = 0; i < WAVEFORM_SAMPLES; i++) {
+      int envelope = i < 20 ? i : (WAVEFORM_SAMPLES - i) / 2;
+      waveform[i].time = i * 50;
+      waveform[i].pga = (uint16_t) (envelope * 40);
+      waveform[i].si = (uint16_t) (envelope * 2);
+   }
+
+   simulator.setInterruptPins(PIN_INT1, PIN_INT2);
+
+   d7s.begin(D7S_I2C_FAST_MODE);
+   d7s.enableInterruptINT1(PIN_INT1);
+   d7s.enableInterruptINT2(PIN_INT2);
+   d7s.startInterruptHandling();
+   d7s.setCapture(&capture);
+
+   //initial installation
+   d7s.initialize();
+   while (!d7s.isReady()) {
+      delay(100);
+   }
+   d7s.processEvents();
+
+   //sample slowly until the trigger (long enough to fill the pre-trigger ring), as fast as the bus allows during the earthquake
+   uint32_t samples = 0;
+   uint32_t playAt = millis() + (D7S_CAPTURE_PRETRIGGER + 8) * IDLE_PERIOD;
+   while (capture.getState() != D7S_CAPTURE_COMPLETE && millis() < 60000) {
+      if (!simulator.isPlaying() && playAt != 0 && millis() >= playAt) {
+         simulator.playWaveform(waveform, WAVEFORM_SAMPLES);
+         playAt = 0;
+      }
+      d7s.acquireSample();
+      d7s.processEvents();
+      samples++;
+      delay(capture.isTriggered() ? d7s.getCapturePeriod() : IDLE_PERIOD);
+   }
+
+   //the capture is read in place
+   D7SCaptureSpan span = capture.getCapture();
+   printf("%u samples taken, capture of %u samples (%u pre-trigger, %u truncated), period while triggered %u ms\n", (unsigned) samples, span.count, span.trigger, (unsigned) span.truncated, d7s.getCapturePeriod());
+   printf("trigger at %u ms, end at %u ms\n", (unsigned) span.triggerTime, (unsigned) span.endTime);
+   if (span.truncated) {
+      printf("warning: the buffer was full, the last %u samples of the earthquake are missing (raise D7S_CAPTURE_SIZE or the sampling period)\n", (unsigned) span.truncated);
+   }
+   for (uint16_t i = 0; i < span.count; i += 25) {
+      const D7SCaptureSample &sample = span.samples[i];
+      printf("%c [%6u ms] si=%u pga=%u\n", i < span.trigger ? '-' : '+', (unsigned) sample.timestamp, sample.si, sample.pga);
+   }
+
+   capture.rearm();
+   return 0;
+}
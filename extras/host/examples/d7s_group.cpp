@@ -0,0 +1,61 @@
+//two simulated d7s on two buses sampled as a group: interrupts are routed to their own instance and the group votes
+//build from the library root:
+//   g++ -std=c++11 -O2 -Isrc -Iextras/host src/*.cpp extras/host/D7SHostPlatform.cpp extras/host/D7SSimulator.cpp extras/host/examples/d7s_group.cpp -o d7s_group
+
+#include <stdio.h>
+
+#include "D7S.h"
+#include "D7SGroup.h"
+#include "D7SSimulator.h"
+
+static D7SSimulator simulatorA, simulatorB;
+static D7SClass sensorA(simulatorA), sensorB(simulatorB);
+static D7SGroup group;
+
+//a 4 s earthquake sampled every 100 ms, the second sensor sees it weaker
+static D7SSimSample waveformA[40], waveformB[40];
+
+static void startA() {
+   printf("[%6u ms] sensor A: START_EARTHQUAKE\n", (unsigned) millis());
+}
+
+static void startB() {
+   printf("[%6u ms] sensor B: START_EARTHQUAKE\n", (unsigned) millis());
+}
+
+static void setupSensor(D7SClass &d7s, D7SSimulator &simulator, uint8_t pinINT1, uint8_t pinINT2, void (*start)()) {
+   simulator.setInterruptPins(pinINT1, pinINT2);
+   d7s.begin(D7S_I2C_FAST_MODE);
+   d7s.enableInterruptINT1(pinINT1);
+   d7s.enableInterruptINT2(pinINT2);
+   d7s.registerInterruptEventHandler(START_EARTHQUAKE, start);
+   d7s.startInterruptHandling();
+}
+
+int main() {
+   for (int i = 0; i < 40; i++) {
+      int envelope = i < 20 ? i : 40 - i;
+      waveformA[i].time = waveformB[i].time = i * 100;
+      waveformA[i].pga = (uint16_t) (envelope * 30);
+      waveformA[i].si = (uint16_t) envelope;
+      waveformB[i].pga = (uint16_t) (envelope * 20);
+      waveformB[i].si = (uint16_t) (envelope / 2);
+   }
+
+   setupSensor(sensorA, simulatorA, 2, 3, startA);
+   setupSensor(sensorB, simulatorB, 4, 5, startB);
+   group.add(sensorA, 0);
+   group.add(sensorB, 1);
+
+   simulatorA.playWaveform(waveformA, 40);
+   simulatorB.playWaveform(waveformB, 40);
+   for (int i = 0; i < 12; i++) {
+      D7SGroupSample sample;
+      group.sample(sample);
+      sensorA.processEvents();
+      sensorB.processEvents();
+      printf("[%6u ms] valid=%u votes=%u median si=%u pga=%u (A pga=%u, B pga=%u) pass %u us\n", (unsigned) millis(), sample.valid, sample.earthquakeVotes, sample.si, sample.pga, sample.snapshots[0].pga, sample.snapshots[1].pga, (unsigned) sample.duration);
+      delay(500);
+   }
+   return 0;
+}
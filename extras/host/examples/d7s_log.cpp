@@ -0,0 +1,109 @@
+//create, scan and query an event log file (same layout as the ESP32 flash partition)
+//build from the library root:
+//   g++ -std=c++11 -O2 -Isrc -Iextras/host src/*.cpp extras/host/D7SHostPlatform.cpp extras/host/D7SFileStorage.cpp extras/host/examples/d7s_log.cpp -o d7s_log
+//usage:
+//   d7s_log fill <file> <events> [capacity]     append synthetic events (one per hour from time 0)
+//   d7s_log dump <file>                         print every record, decoded in place from the mapping
+//   d7s_log query <file> <from> <to> [min]      print the records with from <= time <= to and intensity >= min
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "D7SEventLog.h"
+#include "D7SFileStorage.h"
+
+static void print(const D7SLogRecord &record, void *ctx) {
+   (void) ctx;
+   printf("#%u time=%u duration=%u ms si=%u pga=%u temperature=%d intensity=%u flags=0x%02x samples=%u\n", (unsigned) record.sequence, (unsigned) record.time, (unsigned) record.duration, record.si, record.pga, record.temperature, record.intensity, record.flags, record.samples);
+}
+
+static int fill(const char *path, uint32_t events, uint32_t capacity) {
+   D7SFileStorage storage;
+   if (!storage.open(path, capacity)) {
+      printf("cannot open %s\n", path);
+      return 1;
+   }
+   D7SEventLog log(storage);
+   if (!log.begin()) {
+      printf("the storage is too small\n");
+      return 1;
+   }
+
+   //continue after the last event of the file (slots skipped after a torn write are not valid)
+   D7SLogRecord last;
+   uint32_t time = 0;
+   for (uint32_t index = log.size(); index > 0; index--) {
+      if (log.get(index - 1, last)) {
+         time = last.time + 3600;
+         break;
+      }
+   }
+
+   srand(events);
+   for (uint32_t i = 0; i < events; i++) {
+      D7SRecord record = {};
+      record.si = (uint16_t) (rand() % 200);
+      record.pga = (uint16_t) (rand() % 3000);
+      record.temperature = (int16_t) (200 + rand() % 100);
+      //the queue is written in batches
+      while (!log.appendRecord(record, time)) {
+         log.flush();
+      }
+      log.service();
+      time += 3600;
+   }
+   log.flush();
+   printf("%u record slots in the log, %u dropped\n", (unsigned) log.size(), (unsigned) log.getDropped());
+   return 0;
+}
+
+static int dump(const char *path) {
+   D7SFileStorage storage;
+   if (!storage.open(path, 0, true)) {
+      printf("cannot open %s\n", path);
+      return 1;
+   }
+   //scan the mapping in place, physical order
+   const uint8_t *data = storage.data();
+   uint32_t valid = 0;
+   for (uint32_t offset = 0; offset < storage.capacity(); offset += D7S_LOG_RECORD_SIZE) {
+      D7SLogRecord record;
+      if (D7SEventLog::decode(data + offset, record)) {
+         print(record, NULL);
+         valid++;
+      }
+   }
+   printf("%u valid records\n", (unsigned) valid);
+   return 0;
+}
+
+static int query(const char *path, uint32_t from, uint32_t to, uint8_t minIntensity) {
+   D7SFileStorage storage;
+   if (!storage.open(path, 0, true)) {
+      printf("cannot open %s\n", path);
+      return 1;
+   }
+   D7SEventLog log(storage);
+   if (!log.begin()) {
+      printf("not a log\n");
+      return 1;
+   }
+   uint32_t matched = log.query(from, to, minIntensity, print, NULL);
+   printf("%u records matched\n", (unsigned) matched);
+   return 0;
+}
+
+int main(int argc, char **argv) {
+   if (argc >= 4 && strcmp(argv[1], "fill") == 0) {
+      return fill(argv[2], (uint32_t) atol(argv[3]), argc > 4 ? (uint32_t) atol(argv[4]) : 64 * 1024);
+   }
+   if (argc == 3 && strcmp(argv[1], "dump") == 0) {
+      return dump(argv[2]);
+   }
+   if (argc >= 5 && strcmp(argv[1], "query") == 0) {
+      return query(argv[2], (uint32_t) atol(argv[3]), (uint32_t) atol(argv[4]), argc > 5 ? (uint8_t) atoi(argv[5]) : 0);
+   }
+   printf("usage: d7s_log fill <file> <events> [capacity] | dump <file> | query <file> <from> <to> [min]\n");
+   return 1;
+}
@@ -0,0 +1,95 @@
+//compare the bus traffic of fixed-period polling with the adaptive scheduler on the simulated d7s
+//build from the library root:
+//   g++ -std=c++11 -O2 -Isrc -Iextras/host src/*.cpp extras/host/D7SHostPlatform.cpp extras/host/D7SSimulator.cpp extras/host/examples/d7s_scheduler.cpp -o d7s_scheduler
+
+#include <stdio.h>
+
+#include "D7S.h"
+#include "D7SScheduler.h"
+#include "D7SSimulator.h"
+
+#define PIN_INT1 2
+#define PIN_INT2 3
+
+#define DURATION 600000 //simulated time [ms]
+#define EARTHQUAKE_AT 300000 //start of the earthquake [ms]
+#define POLL_PERIOD 500 //period of the fixed polling [ms]
+
+static D7SSimulator simulator;
+static D7SClass d7s(simulator);
+
+//a 6 s earthquake sampled every 50 ms: ramp up to 0.8 m/s^2, then decay
+static D7SSimSample waveform[120];
+
+//bring the simulated sensor up
+static void setup() {
+   simulator.setInterruptPins(PIN_INT1, PIN_INT2);
+   d7s.begin(D7S_I2C_FAST_MODE);
+   d7s.enableInterruptINT1(PIN_INT1);
+   d7s.enableInterruptINT2(PIN_INT2);
+   d7s.startInterruptHandling();
+   d7s.initialize();
+   while (!d7s.isReady()) {
+      delay(100);
+   }
+   d7s.processEvents();
+}
+
+//play the waveform once its time has come
+static void play(uint32_t start) {
+   static bool played = false;
+   if (!played && millis() - start >= EARTHQUAKE_AT) {
+      simulator.playWaveform(waveform, 120);
+      played = true;
+   }
+}
+
+int main() {
+   for (int i = 0; i < 120; i++) {
+      int envelope = i < 40 ? i : (120 - i) / 2;
+      waveform[i].time = i * 50;
+      waveform[i].pga = (uint16_t) (envelope * 20);
+      waveform[i].si = (uint16_t) envelope;
+   }
+   setup();
+
+   //adaptive: no sampling while idle, the active rate from INT2 to 5 s after the end of the earthquake
+   D7SScheduler scheduler(d7s, 0);
+   uint32_t start = millis();
+   uint32_t transfers = simulator.getTransfers();
+   uint32_t activeSamples = 0;
+   uint32_t firstActive = 0;
+   while (millis() - start < DURATION) {
+      play(start);
+      D7SSnapshot snapshot;
+      if (scheduler.run(snapshot)) {
+         if (scheduler.isActive()) {
+            activeSamples++;
+            if (firstActive == 0 && millis() - start >= EARTHQUAKE_AT) {
+               firstActive = millis() - start;
+            }
+         }
+      }
+      //the simulator only moves its INT pins when it is updated, so wait() is unrolled here
+      while (scheduler.getDelay() > 0 && millis() - start < DURATION) {
+         play(start);
+         simulator.update();
+         delay(D7S_SCHEDULER_STEP);
+      }
+   }
+   uint32_t adaptiveTransfers = simulator.getTransfers() - transfers;
+   printf("adaptive: %u samples (%u active), %u transfers, first active sample %u ms after the start of the waveform\n", (unsigned) scheduler.getSamples(), (unsigned) activeSamples, (unsigned) adaptiveTransfers, (unsigned) (firstActive - EARTHQUAKE_AT));
+
+   //fixed polling over the same time
+   uint32_t samples = 0;
+   start = millis();
+   transfers = simulator.getTransfers();
+   while (millis() - start < DURATION) {
+      d7s.acquireSample();
+      d7s.processEvents();
+      samples++;
+      delay(POLL_PERIOD);
+   }
+   printf("fixed %u ms: %u samples, %u transfers\n", POLL_PERIOD, (unsigned) samples, (unsigned) (simulator.getTransfers() - transfers));
+   return 0;
+}
@@ -0,0 +1,111 @@
+//run the library against the simulated d7s: initialize it, play a short earthquake and print what the handlers see
+//build from the library root:
+//   g++ -std=c++11 -O2 -Isrc -Iextras/host src/*.cpp extras/host/D7SHostPlatform.cpp extras/host/D7SSimulator.cpp extras/host/examples/d7s_simulate.cpp -o d7s_simulate
+
+#include <stdio.h>
+
+#include "D7S.h"
+#include "D7SSimulator.h"
+
+#define PIN_INT1 2
+#define PIN_INT2 3
+
+static D7SSimulator simulator;
+static D7SClass d7s(simulator);
+
+//a 10 s earthquake sampled every 100 ms: ramp up to 1.2 m/s^2, then decay
+static D7SSimSample waveform[100];
+
+static void startEarthquake() {
+   printf("[%6u ms] START_EARTHQUAKE\n", (unsigned) millis());
+}
+
+static void endEarthquake(float si, float pga, float temperature) {
+   printf("[%6u ms] END_EARTHQUAKE si=%.3f m/s pga=%.3f m/s^2 temperature=%.1f C\n", (unsigned) millis(), si, pga, temperature);
+}
+
+static void earthquakeStats(const D7SEventStats &stats) {
+   printf("[%6u ms] statistics: %u ms, %u samples, peak pga=%u mm/s^2 at %u ms, peak si=%u mm/s at %u ms, rms pga=%u mm/s^2, intensity %u\n", (unsigned) millis(), (unsigned) stats.duration, (unsigned) stats.samples, stats.peakPGA, (unsigned) (stats.peakPGATime - stats.start), stats.peakSI, (unsigned) (stats.peakSITime - stats.start), stats.rmsPGA, stats.maxIntensity);
+   for (uint8_t level = 1; level <= stats.maxIntensity; level++) {
+      printf("           at or above intensity %u: %u ms\n", level, (unsigned) stats.timeAbove[level]);
+   }
+}
+
+//subscriber with its own state: the payload is read once per event and shared with the handlers above
+struct EventLog {
+   const char *name;
+   unsigned events;
+};
+
+static EventLog eventLog = {"log", 0};
+
+static void logEvent(const D7SEvent &event, void *ctx) {
+   EventLog *log = (EventLog *) ctx;
+   log->events++;
+   printf("[%6u ms] %s #%u: event %d at %u ms, state=%d pga=%u mm/s^2", (unsigned) millis(), log->name, log->events, event.event, (unsigned) event.timestamp, event.snapshot.state, event.snapshot.pga);
+   if (event.record != NULL) {
+      printf(", record pga=%u mm/s^2", event.record->pga);
+   }
+   printf("\n");
+}
+
+#if defined(D7S_TRACE)
+//line writer of the trace dump
+static void printLine(const char *line, void *ctx) {
+   (void) ctx;
+   puts(line);
+}
+#endif
+
+static void shutoff() {
+   printf("[%6u ms] SHUTOFF_EVENT\n", (unsigned) millis());
+}
+
+int main() {
+   //build the waveform
+   for (int i = 0; i < 100; i++) {
+      int envelope = i < 30 ? i : (100 - i) * 30 / 70;
+      waveform[i].time = i * 100;
+      waveform[i].pga = (uint16_t) (envelope * 40);
+      waveform[i].si = (uint16_t) (envelope * 2);
+   }
+
+   //connect the simulated INT1/INT2 lines
+   simulator.setInterruptPins(PIN_INT1, PIN_INT2);
+
+   d7s.begin();
+   d7s.enableInterruptINT1(PIN_INT1);
+   d7s.enableInterruptINT2(PIN_INT2);
+   d7s.registerInterruptEventHandler(START_EARTHQUAKE, startEarthquake);
+   d7s.registerInterruptEventHandler(END_EARTHQUAKE, endEarthquake);
+   d7s.registerInterruptEventHandler(END_EARTHQUAKE, earthquakeStats);
+   d7s.registerInterruptEventHandler(SHUTOFF_EVENT, shutoff);
+   d7s.subscribe(START_EARTHQUAKE, logEvent, &eventLog);
+   d7s.subscribe(END_EARTHQUAKE, logEvent, &eventLog);
+   d7s.startInterruptHandling();
+
+   //initial installation
+   d7s.initialize();
+   while (!d7s.isReady()) {
+      delay(100);
+   }
+   d7s.processEvents();
+   printf("[%6u ms] initialized\n", (unsigned) millis());
+
+   //play the earthquake and poll every 500 ms like the examples do
+   simulator.playWaveform(waveform, 100);
+   for (int i = 0; i < 30; i++) {
+      D7SSnapshot snapshot = d7s.acquireSample();
+      printf("[%6u ms] state=%d si=%u pga=%u intensity=%u\n", (unsigned) snapshot.timestamp, snapshot.state, snapshot.si, snapshot.pga, d7s.getIntensity(snapshot));
+      d7s.processEvents();
+      delay(500);
+   }
+
+   #if defined(D7S_TRACE)
+      //with -DD7S_TRACE the last register accesses are dumped for d7s_trace_decode
+      d7sTrace.dump(printLine, NULL);
+   #endif
+
+   printf("bus: %u transfers, %u us on the wire, %u retries, %u failures\n", (unsigned) simulator.getTransfers(), (unsigned) simulator.getBusTime(), (unsigned) d7s.getBusRetries(), (unsigned) d7s.getBusFailures());
+   return 0;
+}
@@ -0,0 +1,71 @@
+//decode telemetry frames (one hex-encoded frame per line, as dumped by a LoRa receiver) and print their samples
+//build from the library root:
+//   g++ -std=c++11 -O2 -Isrc src/D7STelemetry.cpp extras/host/examples/d7s_telemetry_decode.cpp -o d7s_telemetry_decode
+//usage:
+//   ./d7s_telemetry_decode < frames.txt
+
+#include <stdio.h>
+#include <ctype.h>
+
+#include "D7STelemetry.h"
+
+//value of a hex digit, -1 if it is not one
+static int hexValue(int c) {
+   if (c >= '0' && c <= '9') {
+      return c - '0';
+   }
+   c = tolower(c);
+   if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+   }
+   return -1;
+}
+
+int main() {
+   char line[1024];
+   uint8_t frame[sizeof(line) / 2];
+   unsigned frames = 0, invalid = 0;
+
+   while (fgets(line, sizeof(line), stdin)) {
+      //parse the hex digits of the line, anything else is a separator
+      size_t length = 0;
+      int high = -1;
+      for (char *c = line; *c; c++) {
+         int value = hexValue(*c);
+         if (value < 0) {
+            continue;
+         }
+         if (high < 0) {
+            high = value;
+         } else {
+            frame[length++] = (uint8_t) ((high << 4) | value);
+            high = -1;
+         }
+      }
+      if (length == 0) {
+         continue;
+      }
+
+      D7STelemetryDecoder decoder;
+      if (!decoder.begin(frame, length)) {
+         printf("invalid frame (%u bytes)\n", (unsigned) length);
+         invalid++;
+         continue;
+      }
+      frames++;
+      printf("node %u: %u samples in %u bytes\n", (unsigned) decoder.nodeId(), decoder.count(), (unsigned) length);
+
+      D7STelemetrySample sample;
+      uint8_t read = 0;
+      while (decoder.next(sample)) {
+         printf("   #%u [%u ms] state=%u si=%u pga=%u intensity=%u\n", (unsigned) sample.sequence, (unsigned) sample.timestamp, sample.state, sample.si, sample.pga, sample.intensity);
+         read++;
+      }
+      if (read != decoder.count()) {
+         printf("   malformed frame after %u samples\n", read);
+      }
+   }
+
+   printf("%u frames, %u invalid\n", frames, invalid);
+   return invalid ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+//decode a trace dump (D7STrace::dump(), e.g. captured from the serial port) and print the timeline of the bus
+//build from the library root:
+//   g++ -std=c++11 -O2 -Isrc src/D7STrace.cpp extras/host/examples/d7s_trace_decode.cpp -o d7s_trace_decode
+//usage:
+//   ./d7s_trace_decode < dump.txt
+//anything before the D7ST header line and after the END line (other serial output) is ignored
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <vector>
+
+#include "D7S.h"
+
+//public methods in d7s_api order
+static const char *apiNames[] = {
+   "-", "getState", "getAxisInUse", "setThreshold", "setAxis", "getLastestPGV", "getLastestPGA", "getLatestRecord", "getRankedRecord",
+   "getInstantaneusPGV", "getInstantaneusPGA", "getIntensity", "getSnapshot", "clear", "initialize", "selftest", "getSelftestResult",
+   "acquireOffset", "getAcquireOffsetResult", "isInCollapse", "isInShutoff", "resetEvents", "isEarthquakeOccuring", "isReady",
+   "processEvents", "acquireSample", "getLastestTemperature", "readHistory", "updateHistory", "pollOperation"
+};
+static_assert(sizeof(apiNames) / sizeof(apiNames[0]) == D7S_API_COUNT, "apiNames must follow d7s_api");
+
+//d7s_bus_status names
+static const char *statusNames[] = {"OK", "NACK_ADDRESS", "NACK_DATA", "SHORT_READ", "TIMEOUT", "ERROR", "LOCKED", "NOT_SAMPLER"};
+
+//per register totals
+struct RegisterTotals {
+   uint16_t reg;
+   uint8_t op;
+   uint32_t count;
+   uint32_t failures;
+   uint32_t retries;
+   uint64_t duration;
+   uint16_t maxDuration;
+};
+
+static RegisterTotals totals[64];
+static uint8_t totalsCount = 0;
+
+static void account(const D7STraceRecord &record) {
+   RegisterTotals *entry = NULL;
+   for (uint8_t i = 0; i < totalsCount; i++) {
+      if (totals[i].reg == record.reg && totals[i].op == record.op) {
+         entry = &totals[i];
+      }
+   }
+   if (entry == NULL) {
+      if (totalsCount == sizeof(totals) / sizeof(totals[0])) {
+         return;
+      }
+      entry = &totals[totalsCount++];
+      memset(entry, 0, sizeof(*entry));
+      entry->reg = record.reg;
+      entry->op = record.op;
+   }
+   entry->count++;
+   entry->failures += record.status != D7S_BUS_OK;
+   entry->retries += record.attempts > 1 ? record.attempts - 1 : 0;
+   entry->duration += record.duration;
+   if (record.duration > entry->maxDuration) {
+      entry->maxDuration = record.duration;
+   }
+}
+
+//print the records of a dump in time order
+//an access is recorded when it ends with the time it started, so an edge that happened during it is recorded first
+static void printDump(std::vector<D7STraceRecord> &records) {
+   if (records.empty()) {
+      return;
+   }
+   uint32_t first = records[0].timestamp;
+   for (size_t i = 1; i < records.size(); i++) {
+      if ((int32_t) (records[i].timestamp - first) < 0) {
+         first = records[i].timestamp;
+      }
+   }
+   std::stable_sort(records.begin(), records.end(), [first](const D7STraceRecord &a, const D7STraceRecord &b) {
+      return a.timestamp - first < b.timestamp - first;
+   });
+
+   uint32_t previous = first;
+   for (size_t i = 0; i < records.size(); i++) {
+      const D7STraceRecord &record = records[i];
+      //time from the first record and from the previous one
+      printf("[%10u us] +%7u #%u ", (unsigned) (record.timestamp - first), (unsigned) (record.timestamp - previous), record.instance);
+      previous = record.timestamp;
+      const char *status = record.status < sizeof(statusNames) / sizeof(statusNames[0]) ? statusNames[record.status] : "?";
+      const char *api = record.api < D7S_API_COUNT ? apiNames[record.api] : "?";
+      switch (record.op) {
+         case D7S_TRACE_READ:
+            printf("R 0x%04X x%u = 0x%0*X %-12s %5u us %u attempt(s) %s\n", record.reg, record.length, record.length > 1 ? 4 : 2, record.value, status, record.duration, record.attempts, api);
+            account(record);
+            break;
+         case D7S_TRACE_WRITE:
+            printf("W 0x%04X   <- 0x%02X   %-12s %5u us %u attempt(s) %s\n", record.reg, record.value, status, record.duration, record.attempts, api);
+            account(record);
+            break;
+         case D7S_TRACE_INT1:
+         case D7S_TRACE_INT2:
+            printf("INT%u %s\n", record.op == D7S_TRACE_INT1 ? 1 : 2, record.value ? "HIGH" : "LOW");
+            break;
+         default:
+            printf("unknown record %u\n", record.op);
+      }
+   }
+   records.clear();
+}
+
+//value of a hex digit, -1 if it is not one
+static int hexValue(int c) {
+   if (c >= '0' && c <= '9') {
+      return c - '0';
+   }
+   c = tolower(c);
+   if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+   }
+   return -1;
+}
+
+int main() {
+   char line[256];
+   bool inDump = false;
+   unsigned malformed = 0;
+   std::vector<D7STraceRecord> records;
+
+   while (fgets(line, sizeof(line), stdin)) {
+      line[strcspn(line, "\r\n")] = '\0';
+      if (!inDump) {
+         unsigned version;
+         unsigned long written, dumped;
+         if (sscanf(line, "D7ST %u %lu %lu", &version, &written, &dumped) == 3) {
+            if (version != D7S_TRACE_VERSION) {
+               fprintf(stderr, "unsupported trace version %u\n", version);
+               return 1;
+            }
+            printDump(records);
+            printf("trace: %lu records written, last %lu kept\n", written, dumped);
+            inDump = true;
+         }
+         continue;
+      }
+      if (!strcmp(line, "END")) {
+         printDump(records);
+         inDump = false;
+         continue;
+      }
+
+      //one record per line
+      uint8_t data[D7S_TRACE_RECORD_SIZE];
+      bool valid = strlen(line) == 2 * D7S_TRACE_RECORD_SIZE;
+      for (uint8_t i = 0; valid && i < D7S_TRACE_RECORD_SIZE; i++) {
+         int high = hexValue(line[2 * i]);
+         int low = hexValue(line[2 * i + 1]);
+         valid = high >= 0 && low >= 0;
+         data[i] = (uint8_t) ((high << 4) | low);
+      }
+      if (!valid) {
+         malformed++;
+         continue;
+      }
+      D7STraceRecord record;
+      D7STrace::decode(data, record);
+      records.push_back(record);
+   }
+   printDump(records);
+
+   //summary per register
+   printf("\nregister  op    count failures retries  avg us  max us\n");
+   for (uint8_t i = 0; i < totalsCount; i++) {
+      const RegisterTotals &entry = totals[i];
+      printf("0x%04X    %s  %7u %8u %7u %7u %7u\n", entry.reg, entry.op == D7S_TRACE_READ ? "R" : "W", (unsigned) entry.count, (unsigned) entry.failures, (unsigned) entry.retries, (unsigned) (entry.duration / entry.count), entry.maxDuration);
+   }
+   if (malformed) {
+      printf("%u malformed lines\n", malformed);
+   }
+   return malformed ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+#include "D7SGateway.h"
+
+#include <string.h>
+#include <chrono>
+
+D7SGateway::D7SGateway(const D7SGatewayConfig &config, d7s_network_callback callback, void *ctx) {
+   _config = config;
+   if (_config.workers == 0) {
+      _config.workers = 1;
+   }
+   _callback = callback;
+   _ctx = ctx;
+   _lanes = new Lane[_config.workers];
+   for (unsigned i = 0; i < _config.workers; i++) {
+      _lanes[i].queue.resize(D7S_GATEWAY_QUEUE);
+      _lanes[i].head = 0;
+      _lanes[i].count = 0;
+   }
+   _running = false;
+   _networkActive = false;
+   _received = 0;
+   _dropped = 0;
+   _invalid = 0;
+   _duplicates = 0;
+   _late = 0;
+   _samples = 0;
+   _processed = 0;
+   _networkEvents = 0;
+   for (int i = 0; i < D7S_GATEWAY_LATENCY_BUCKETS; i++) {
+      _latency[i] = 0;
+   }
+   _maxLatency = 0;
+}
+
+D7SGateway::~D7SGateway() {
+   stop();
+   delete[] _lanes;
+}
+
+//steady clock [us]
+uint64_t D7SGateway::now() {
+   return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//start the workers
+void D7SGateway::start() {
+   std::lock_guard<std::mutex> guard(_runLock);
+   if (_running) {
+      return;
+   }
+   _running = true;
+   for (unsigned i = 0; i < _config.workers; i++) {
+      _lanes[i].thread = std::thread(&D7SGateway::work, this, &_lanes[i]);
+   }
+}
+
+//process the queued frames and stop the workers
+void D7SGateway::stop() {
+   std::lock_guard<std::mutex> guard(_runLock);
+   if (!_running) {
+      return;
+   }
+   for (unsigned i = 0; i < _config.workers; i++) {
+      {
+         std::lock_guard<std::mutex> laneGuard(_lanes[i].lock);
+         _running = false;
+      }
+      _lanes[i].notEmpty.notify_all();
+   }
+   for (unsigned i = 0; i < _config.workers; i++) {
+      _lanes[i].thread.join();
+   }
+}
+
+//node of a frame, read from the header without checking the CRC (a bad frame is rejected by the worker)
+uint32_t D7SGateway::peekNode(const uint8_t *frame, size_t length) {
+   uint32_t nodeId = 0;
+   for (size_t i = 1; i < length && i < 6; i++) {
+      nodeId |= (uint32_t) (frame[i] & 0x7F) << (7 * (i - 1));
+      if (!(frame[i] & 0x80)) {
+         break;
+      }
+   }
+   return nodeId;
+}
+
+//queue a frame (time 0 = now), false if dropped (queue full and !wait)
+bool D7SGateway::submit(const uint8_t *frame, size_t length, bool wait, uint64_t time) {
+   _received++;
+   if (length == 0 || length > D7S_TELEMETRY_MAX_FRAME) {
+      _invalid++;
+      return false;
+   }
+   uint64_t received = now();
+
+   //the frames of a node always go to the same worker
+   Lane &lane = _lanes[peekNode(frame, length) % _config.workers];
+   std::unique_lock<std::mutex> guard(lane.lock);
+   if (lane.count == lane.queue.size()) {
+      if (!wait) {
+         _dropped++;
+         return false;
+      }
+      lane.notFull.wait(guard, [&lane] { return lane.count < lane.queue.size(); });
+   }
+   D7SGatewayFrame &slot = lane.queue[(lane.head + lane.count) % lane.queue.size()];
+   memcpy(slot.data, frame, length);
+   slot.length = (uint8_t) length;
+   slot.received = received;
+   slot.time = time ? time : received / 1000;
+   lane.count++;
+   guard.unlock();
+   lane.notEmpty.notify_one();
+   return true;
+}
+
+//body of a worker
+void D7SGateway::work(Lane *lane) {
+   while (true) {
+      D7SGatewayFrame frame;
+      {
+         std::unique_lock<std::mutex> guard(lane->lock);
+         lane->notEmpty.wait(guard, [this, lane] { return lane->count > 0 || !_running; });
+         //stop only once the queue is empty
+         if (lane->count == 0) {
+            return;
+         }
+         frame = lane->queue[lane->head];
+         lane->head = (lane->head + 1) % lane->queue.size();
+         lane->count--;
+      }
+      lane->notFull.notify_one();
+
+      process(frame);
+
+      //ingest latency in log2 buckets
+      uint64_t latency = now() - frame.received;
+      int bucket = 0;
+      while (bucket < D7S_GATEWAY_LATENCY_BUCKETS - 1 && (latency >> (bucket + 1)) != 0) {
+         bucket++;
+      }
+      _latency[bucket]++;
+      uint64_t max = _maxLatency;
+      while (latency > max && !_maxLatency.compare_exchange_weak(max, latency)) {
+      }
+      _processed++;
+   }
+}
+
+//decode a frame and apply it
+void D7SGateway::process(const D7SGatewayFrame &frame) {
+   //check and decode outside of any lock
+   D7STelemetryDecoder decoder;
+   if (!decoder.begin(frame.data, frame.length)) {
+      _invalid++;
+      return;
+   }
+   D7STelemetrySample samples[D7S_TELEMETRY_MAX_FRAME];
+   uint8_t count = 0;
+   while (count < decoder.count() && decoder.next(samples[count])) {
+      count++;
+   }
+   if (count != decoder.count()) {
+      _invalid++;
+      return;
+   }
+
+   uint32_t nodeId = decoder.nodeId();
+   uint32_t fresh = 0;
+   bool duplicate = false;
+   bool exceeded = false;
+   {
+      Shard &shard = _shards[nodeId % D7S_GATEWAY_SHARDS];
+      std::lock_guard<std::mutex> guard(shard.lock);
+      Node &node = shard.nodes[nodeId];
+      node.state.nodeId = nodeId;
+      uint32_t late = node.state.late;
+      for (uint8_t i = 0; i < count; i++) {
+         const D7STelemetrySample &sample = samples[i];
+         if (!accept(node, sample.sequence)) {
+            continue;
+         }
+         fresh++;
+         if (sample.intensity >= _config.level) {
+            exceeded = true;
+         }
+         //the latest sample is the state of the node
+         if (sample.sequence == node.state.sequence) {
+            node.state.timestamp = sample.timestamp;
+            node.state.state = sample.state;
+            node.state.intensity = sample.intensity;
+            node.state.si = sample.si;
+            node.state.pga = sample.pga;
+         }
+      }
+      node.state.lastSeen = frame.time;
+      //a frame that only carried samples already received (not too late to tell)
+      duplicate = fresh == 0 && late == node.state.late;
+      if (duplicate) {
+         node.state.duplicates++;
+      } else if (fresh > 0) {
+         node.state.frames++;
+         node.state.samples += fresh;
+      }
+      if (exceeded) {
+         node.state.lastExceed = frame.time;
+      }
+   }
+   if (duplicate) {
+      _duplicates++;
+   }
+   _samples += fresh;
+
+   if (exceeded) {
+      exceed(nodeId, frame.time);
+   } else if (_networkActive) {
+      expire(frame.time);
+   }
+}
+
+//dedupe a sample, true if it is new
+bool D7SGateway::accept(Node &node, uint32_t sequence) {
+   uint32_t bit = sequence % D7S_GATEWAY_DEDUPE_WINDOW;
+   if (!node.started) {
+      memset(node.seen, 0, sizeof(node.seen));
+      node.started = true;
+      node.state.sequence = sequence;
+   } else if ((int32_t) (sequence - node.state.sequence) > 0) {
+      //newer: forget the slots between the previous highest sequence and this one
+      uint32_t gap = sequence - node.state.sequence;
+      if (gap >= D7S_GATEWAY_DEDUPE_WINDOW) {
+         memset(node.seen, 0, sizeof(node.seen));
+      } else {
+         for (uint32_t s = node.state.sequence + 1; s != sequence; s++) {
+            uint32_t clear = s % D7S_GATEWAY_DEDUPE_WINDOW;
+            node.seen[clear / 64] &= ~((uint64_t) 1 << (clear % 64));
+         }
+      }
+      node.state.lost += gap - 1;
+      node.state.sequence = sequence;
+   } else {
+      //older: too old to tell, or already received
+      if (node.state.sequence - sequence >= D7S_GATEWAY_DEDUPE_WINDOW) {
+         node.state.late++;
+         _late++;
+         return false;
+      }
+      if (node.seen[bit / 64] & ((uint64_t) 1 << (bit % 64))) {
+         return false;
+      }
+      //a late sample fills a gap
+      if (node.state.lost > 0) {
+         node.state.lost--;
+      }
+   }
+   node.seen[bit / 64] |= (uint64_t) 1 << (bit % 64);
+   return true;
+}
+
+//a node reached the detection level
+void D7SGateway::exceed(uint32_t nodeId, uint64_t time) {
+   std::lock_guard<std::mutex> guard(_detectionLock);
+   uint64_t &last = _exceeding[nodeId];
+   if (time > last) {
+      last = time;
+   }
+   //drop the nodes out of the window
+   for (std::map<uint32_t, uint64_t>::iterator i = _exceeding.begin(); i != _exceeding.end();) {
+      if (i->second + _config.window < time) {
+         i = _exceeding.erase(i);
+      } else {
+         ++i;
+      }
+   }
+   unsigned nodes = (unsigned) _exceeding.size();
+   if (!_networkActive && nodes >= _config.nodes) {
+      _networkActive = true;
+      _networkEvents++;
+      if (_callback) {
+         _callback(true, nodes, time, _ctx);
+      }
+   }
+}
+
+//drop the nodes out of the window, end the network event
+void D7SGateway::expire(uint64_t time) {
+   std::lock_guard<std::mutex> guard(_detectionLock);
+   for (std::map<uint32_t, uint64_t>::iterator i = _exceeding.begin(); i != _exceeding.end();) {
+      if (i->second + _config.window < time) {
+         i = _exceeding.erase(i);
+      } else {
+         ++i;
+      }
+   }
+   unsigned nodes = (unsigned) _exceeding.size();
+   if (_networkActive && nodes < _config.nodes) {
+      _networkActive = false;
+      if (_callback) {
+         _callback(false, nodes, time, _ctx);
+      }
+   }
+}
+
+//copy the state of a node, false if unknown
+bool D7SGateway::getNode(uint32_t nodeId, D7SNodeState &state) {
+   Shard &shard = _shards[nodeId % D7S_GATEWAY_SHARDS];
+   std::lock_guard<std::mutex> guard(shard.lock);
+   std::unordered_map<uint32_t, Node>::iterator i = shard.nodes.find(nodeId);
+   if (i == shard.nodes.end()) {
+      return false;
+   }
+   state = i->second.state;
+   return true;
+}
+
+//copy the whole table
+void D7SGateway::getNodes(std::vector<D7SNodeState> &nodes) {
+   nodes.clear();
+   for (int i = 0; i < D7S_GATEWAY_SHARDS; i++) {
+      std::lock_guard<std::mutex> guard(_shards[i].lock);
+      for (std::unordered_map<uint32_t, Node>::iterator node = _shards[i].nodes.begin(); node != _shards[i].nodes.end(); ++node) {
+         nodes.push_back(node->second.state);
+      }
+   }
+}
+
+//copy the counters
+void D7SGateway::getStats(D7SGatewayStats &stats) {
+   stats.received = _received;
+   stats.dropped = _dropped;
+   stats.invalid = _invalid;
+   stats.duplicates = _duplicates;
+   stats.late = _late;
+   stats.samples = _samples;
+   stats.processed = _processed;
+   stats.networkEvents = _networkEvents;
+   stats.nodes = 0;
+   for (int i = 0; i < D7S_GATEWAY_SHARDS; i++) {
+      std::lock_guard<std::mutex> guard(_shards[i].lock);
+      stats.nodes += _shards[i].nodes.size();
+   }
+   for (int i = 0; i < D7S_GATEWAY_LATENCY_BUCKETS; i++) {
+      stats.latency[i] = _latency[i];
+   }
+   stats.maxLatency = _maxLatency;
+}
+
+//upper bound of the ingest latency percentile [us] (never above the maximum latency)
+uint64_t D7SGateway::getLatencyPercentile(double percentile) {
+   uint64_t total = 0;
+   for (int i = 0; i < D7S_GATEWAY_LATENCY_BUCKETS; i++) {
+      total += _latency[i];
+   }
+   if (total == 0) {
+      return 0;
+   }
+   uint64_t target = (uint64_t) (total * percentile / 100.0);
+   uint64_t seen = 0;
+   for (int i = 0; i < D7S_GATEWAY_LATENCY_BUCKETS; i++) {
+      seen += _latency[i];
+      if (seen > target || seen == total) {
+         //the bucket bound can exceed every sample that fell in it
+         uint64_t bound = (uint64_t) 2 << i;
+         uint64_t max = _maxLatency;
+         return bound < max ? bound : max;
+      }
+   }
+   return _maxLatency;
+}
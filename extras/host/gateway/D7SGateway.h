@@ -0,0 +1,158 @@
+#ifndef D7S_GATEWAY_H
+#define D7S_GATEWAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "D7STelemetry.h"
+
+//--- GATEWAY ---
+#define D7S_GATEWAY_QUEUE 4096 //frames waiting for each worker
+#define D7S_GATEWAY_SHARDS 64 //locks of the node table (a node always maps to the same shard)
+#define D7S_GATEWAY_DEDUPE_WINDOW 256 //sequence numbers remembered per node to drop retransmissions (multiple of 64)
+#define D7S_GATEWAY_LATENCY_BUCKETS 32 //log2 buckets of the ingest latency histogram [us]
+
+//frame waiting in the queue
+struct D7SGatewayFrame {
+   uint8_t data[D7S_TELEMETRY_MAX_FRAME];
+   uint8_t length;
+   uint64_t received; //steady clock when the frame was received [us]
+   uint64_t time; //arrival time used by the detection [ms] (the node clocks are not synchronized)
+};
+
+//latest state of a node
+struct D7SNodeState {
+   uint32_t nodeId;
+   uint32_t sequence; //highest sample sequence received
+   uint32_t timestamp; //node millis() of that sample
+   uint8_t state; //d7s_status
+   uint8_t intensity;
+   uint16_t si; //[mm/s]
+   uint16_t pga; //[mm/s^2]
+   uint64_t lastSeen; //arrival time of the last frame [ms]
+   uint64_t lastExceed; //arrival time of the last sample at or above the detection level [ms] (0 = never)
+   uint32_t frames; //frames with at least one new sample
+   uint32_t samples; //new samples
+   uint32_t duplicates; //frames that only carried samples already received
+   uint32_t lost; //samples never received (sequence gaps)
+   uint32_t late; //samples dropped because they arrived after the dedupe window
+};
+
+//network level detection: at least nodes nodes at or above level within window
+struct D7SGatewayConfig {
+   unsigned workers; //parsing threads
+   uint8_t level; //intensity a node must reach
+   unsigned nodes; //nodes needed to declare a network event
+   uint32_t window; //[ms]
+};
+
+//counters of the gateway
+struct D7SGatewayStats {
+   uint64_t received; //frames submitted
+   uint64_t dropped; //frames dropped because the queue was full
+   uint64_t invalid; //frames with a bad CRC or malformed
+   uint64_t duplicates; //frames that only carried samples already received
+   uint64_t late; //samples dropped because they arrived after the dedupe window
+   uint64_t samples; //new samples
+   uint64_t processed; //frames processed by the workers
+   uint64_t networkEvents; //network detections raised
+   size_t nodes; //nodes in the table
+   uint64_t latency[D7S_GATEWAY_LATENCY_BUCKETS]; //frames whose ingest latency is below 2^(i+1) us
+   uint64_t maxLatency; //[us]
+};
+
+//called when the network detection starts (active) or ends
+typedef void (*d7s_network_callback)(bool active, unsigned nodes, uint64_t time, void *ctx);
+
+//multi-node telemetry aggregator
+//submit() routes the raw frames by node to the queue of a worker (so the frames of a node are processed in order),
+//the workers check and decode them, drop the retransmitted samples, update the node table and run the network detection;
+//the latency is measured from submit() to the end of the processing
+class D7SGateway {
+
+   public:
+
+      D7SGateway(const D7SGatewayConfig &config, d7s_network_callback callback = NULL, void *ctx = NULL);
+      ~D7SGateway();
+
+      void start(); //start the workers
+      void stop(); //process the queued frames and stop the workers
+
+      bool submit(const uint8_t *frame, size_t length, bool wait, uint64_t time = 0); //queue a frame (time 0 = now), false if dropped (queue full and !wait)
+      bool getNode(uint32_t nodeId, D7SNodeState &state); //copy the state of a node, false if unknown
+      void getNodes(std::vector<D7SNodeState> &nodes); //copy the whole table
+      void getStats(D7SGatewayStats &stats); //copy the counters
+      uint64_t getLatencyPercentile(double percentile); //upper bound of the ingest latency percentile [us], clamped to the maximum
+
+      static uint64_t now(); //steady clock [us]
+
+   private:
+
+      //node with its dedupe window
+      struct Node {
+         D7SNodeState state;
+         uint64_t seen[D7S_GATEWAY_DEDUPE_WINDOW / 64]; //bit per sequence number (sequence % window)
+         bool started;
+      };
+
+      //queue and thread of a worker (ring of D7S_GATEWAY_QUEUE frames)
+      struct Lane {
+         std::vector<D7SGatewayFrame> queue;
+         size_t head;
+         size_t count;
+         std::mutex lock;
+         std::condition_variable notEmpty;
+         std::condition_variable notFull;
+         std::thread thread;
+      };
+
+      //part of the node table with its lock
+      struct Shard {
+         std::mutex lock;
+         std::unordered_map<uint32_t, Node> nodes;
+      };
+
+      void work(Lane *lane); //body of a worker
+      static uint32_t peekNode(const uint8_t *frame, size_t length); //node of a frame, read from the header without checking the CRC
+      void process(const D7SGatewayFrame &frame); //decode a frame and apply it
+      bool accept(Node &node, uint32_t sequence); //dedupe a sample, true if it is new
+      void exceed(uint32_t nodeId, uint64_t time); //a node reached the detection level
+      void expire(uint64_t time); //drop the nodes out of the window, end the network event
+
+      D7SGatewayConfig _config;
+      d7s_network_callback _callback;
+      void *_ctx;
+
+      //workers
+      Lane *_lanes;
+      std::atomic<bool> _running; //read by the workers without their lane lock
+      std::mutex _runLock;
+
+      Shard _shards[D7S_GATEWAY_SHARDS];
+
+      //network detection
+      std::mutex _detectionLock;
+      std::map<uint32_t, uint64_t> _exceeding; //node -> arrival time of its last sample at or above the level
+      std::atomic<bool> _networkActive;
+
+      //counters
+      std::atomic<uint64_t> _received;
+      std::atomic<uint64_t> _dropped;
+      std::atomic<uint64_t> _invalid;
+      std::atomic<uint64_t> _duplicates;
+      std::atomic<uint64_t> _late;
+      std::atomic<uint64_t> _samples;
+      std::atomic<uint64_t> _processed;
+      std::atomic<uint64_t> _networkEvents;
+      std::atomic<uint64_t> _latency[D7S_GATEWAY_LATENCY_BUCKETS];
+      std::atomic<uint64_t> _maxLatency;
+};
+
+#endif
@@ -0,0 +1,286 @@
+//gateway for the telemetry frames of many nodes: node table, retransmission dedupe and network level detection
+//build from the library root:
+//   g++ -std=c++11 -O2 -pthread -Isrc -Iextras/host/gateway src/D7STelemetry.cpp extras/host/gateway/D7SGateway.cpp extras/host/gateway/d7s_gateway.cpp -o d7s_gateway
+//usage:
+//   ./d7s_gateway [options] file...   frames each preceded by their length byte (- = stdin, the d7s_replay -o format)
+//   ./d7s_gateway [options] -u port    one frame per UDP datagram on 127.0.0.1:port (stand-in for the radio), Ctrl-C to stop
+//   ./d7s_gateway [options] -g nodes,seconds   synthetic load: every node sends a frame of 12 samples every 1.2 s,
+//                                              10% of the frames twice, an earthquake crosses the network halfway
+//   -w workers[,workers...]   parsing threads (a list runs the synthetic load once per value)
+//   -l level     intensity a node must reach (default 4)
+//   -n nodes     nodes needed within the window for a network event (default 3)
+//   -W window    detection window [ms] (default 10000)
+//   -r rate      synthetic load: frames per second (default: as fast as possible)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "D7SGateway.h"
+#include "D7SIntensity.h"
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+   stopRequested = 1;
+}
+
+//network event decisions
+static void networkEvent(bool active, unsigned nodes, uint64_t time, void *ctx) {
+   (void) ctx;
+   printf("[%10llu ms] network event %s: %u nodes at or above the level\n", (unsigned long long) time, active ? "START" : "END", nodes);
+}
+
+static void printStats(D7SGateway &gateway, double elapsed) {
+   D7SGatewayStats stats;
+   gateway.getStats(stats);
+   printf("%llu frames received, %llu processed, %llu duplicates, %llu late samples, %llu invalid, %llu dropped, %llu samples from %u nodes, %llu network events\n", (unsigned long long) stats.received, (unsigned long long) stats.processed, (unsigned long long) stats.duplicates, (unsigned long long) stats.late, (unsigned long long) stats.invalid, (unsigned long long) stats.dropped, (unsigned long long) stats.samples, (unsigned) stats.nodes, (unsigned long long) stats.networkEvents);
+   printf("ingest latency: p50 < %llu us, p99 < %llu us, max %llu us", (unsigned long long) gateway.getLatencyPercentile(50), (unsigned long long) gateway.getLatencyPercentile(99), (unsigned long long) stats.maxLatency);
+   if (elapsed > 0) {
+      printf(", %.0f frames/s", stats.processed / elapsed);
+   }
+   printf("\n");
+}
+
+static void printNodes(D7SGateway &gateway) {
+   std::vector<D7SNodeState> nodes;
+   gateway.getNodes(nodes);
+   std::sort(nodes.begin(), nodes.end(), [](const D7SNodeState &a, const D7SNodeState &b) { return a.nodeId < b.nodeId; });
+   printf("node      sequence  state intensity   si   pga  frames samples dup  lost  late\n");
+   for (size_t i = 0; i < nodes.size() && i < 20; i++) {
+      const D7SNodeState &node = nodes[i];
+      printf("%-9u %8u %6u %9u %4u %5u %7u %7u %3u %5u %5u\n", (unsigned) node.nodeId, (unsigned) node.sequence, node.state, node.intensity, node.si, node.pga, (unsigned) node.frames, (unsigned) node.samples, (unsigned) node.duplicates, (unsigned) node.lost, (unsigned) node.late);
+   }
+   if (nodes.size() > 20) {
+      printf("... %u more nodes\n", (unsigned) (nodes.size() - 20));
+   }
+}
+
+//frames from a file of length-prefixed frames
+static bool readFile(D7SGateway &gateway, const char *name) {
+   FILE *file = strcmp(name, "-") ? fopen(name, "rb") : stdin;
+   if (file == NULL) {
+      perror(name);
+      return false;
+   }
+   uint8_t frame[256];
+   int length;
+   while ((length = fgetc(file)) != EOF) {
+      if (fread(frame, 1, length, file) != (size_t) length) {
+         fprintf(stderr, "%s: truncated frame\n", name);
+         break;
+      }
+      gateway.submit(frame, length, true);
+   }
+   if (file != stdin) {
+      fclose(file);
+   }
+   return true;
+}
+
+//frames from UDP datagrams until Ctrl-C
+static bool readSocket(D7SGateway &gateway, int port) {
+   int fd = socket(AF_INET, SOCK_DGRAM, 0);
+   sockaddr_in address;
+   memset(&address, 0, sizeof(address));
+   address.sin_family = AF_INET;
+   address.sin_port = htons(port);
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if (fd < 0 || bind(fd, (sockaddr *) &address, sizeof(address)) < 0) {
+      perror("udp");
+      return false;
+   }
+   //wake up every second to check for Ctrl-C and print the counters
+   timeval timeout = {1, 0};
+   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   signal(SIGINT, onSignal);
+   printf("listening on 127.0.0.1:%d\n", port);
+
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   uint64_t lastReport = D7SGateway::now();
+   uint8_t frame[256];
+   while (!stopRequested) {
+      ssize_t length = recv(fd, frame, sizeof(frame), 0);
+      if (length > 0) {
+         //the socket must never block on the pipeline: drop when the queue is full
+         gateway.submit(frame, length, false);
+      }
+      if (D7SGateway::now() - lastReport >= 10000000) {
+         lastReport = D7SGateway::now();
+         printStats(gateway, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+      }
+   }
+   close(fd);
+   return true;
+}
+
+//synthetic frame with its arrival time
+struct SyntheticFrame {
+   uint8_t data[D7S_TELEMETRY_MAX_FRAME];
+   uint8_t length;
+   uint64_t time; //[ms]
+};
+
+//frames of nodes nodes over seconds s, in arrival order
+static void generate(unsigned nodes, unsigned seconds, std::vector<SyntheticFrame> &frames) {
+   const uint32_t samplePeriod = 100;
+   const uint32_t framePeriod = 12;
+   const uint32_t quakeStart = seconds * 1000 / 2;
+   std::vector<SyntheticFrame> all;
+   srand(7);
+   for (unsigned node = 0; node < nodes; node++) {
+      D7STelemetryEncoder encoder(1000 + node);
+      uint32_t offset = rand() % 1000; //the nodes are not in phase
+      //the earthquake reaches the nodes one after the other (20 ms apart), 20 s long
+      uint32_t arrival = quakeStart + node * 20;
+      for (uint32_t sequence = 0; sequence * samplePeriod < seconds * 1000; sequence++) {
+         uint32_t time = offset + sequence * samplePeriod;
+         D7STelemetrySample sample;
+         sample.sequence = sequence;
+         sample.timestamp = time;
+         uint16_t pga = rand() % 4;
+         if (time >= arrival && time < arrival + 20000) {
+            uint32_t t = time - arrival;
+            pga += (uint16_t) (t < 5000 ? t / 20 : (20000 - t) / 60);
+         }
+         sample.pga = pga;
+         sample.si = pga / 20;
+         sample.state = pga >= 100 ? 1 : 0;
+         sample.intensity = d7sIntensity(sample.si, sample.pga);
+         encoder.add(sample);
+         if (encoder.count() == framePeriod) {
+            SyntheticFrame frame;
+            const uint8_t *data = encoder.finish(frame.length);
+            memcpy(frame.data, data, frame.length);
+            frame.time = time;
+            all.push_back(frame);
+            //retransmission
+            if (rand() % 10 == 0) {
+               frame.time += 50;
+               all.push_back(frame);
+            }
+            encoder.reset();
+         }
+      }
+   }
+   std::stable_sort(all.begin(), all.end(), [](const SyntheticFrame &a, const SyntheticFrame &b) { return a.time < b.time; });
+   frames.swap(all);
+}
+
+//run the synthetic load on workers threads
+static void runLoad(const std::vector<SyntheticFrame> &frames, D7SGatewayConfig config, double rate, bool verbose) {
+   D7SGateway gateway(config, verbose ? networkEvent : NULL);
+   gateway.start();
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   for (size_t i = 0; i < frames.size(); i++) {
+      if (rate > 0) {
+         std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t) (i * 1000000.0 / rate)));
+      }
+      gateway.submit(frames[i].data, frames[i].length, true, frames[i].time);
+   }
+   gateway.stop();
+   double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   D7SGatewayStats stats;
+   gateway.getStats(stats);
+   printf("%7u %12.0f %9llu %9llu %9llu %7llu %7llu %10llu\n", config.workers, stats.processed / elapsed, (unsigned long long) gateway.getLatencyPercentile(50), (unsigned long long) gateway.getLatencyPercentile(99), (unsigned long long) stats.maxLatency, (unsigned long long) stats.duplicates, (unsigned long long) stats.late, (unsigned long long) stats.networkEvents);
+}
+
+static void usage() {
+   fprintf(stderr, "usage: d7s_gateway [-w workers[,workers...]] [-l level] [-n nodes] [-W window] [-r rate] (file... | -u port | -g nodes,seconds)\n");
+   exit(2);
+}
+
+int main(int argc, char **argv) {
+   D7SGatewayConfig config;
+   config.workers = 4;
+   config.level = 4;
+   config.nodes = 3;
+   config.window = 10000;
+   std::vector<unsigned> workers;
+   int port = 0;
+   unsigned loadNodes = 0, loadSeconds = 60;
+   double rate = 0;
+
+   int arg = 1;
+   for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++) {
+      const char *option = argv[arg];
+      if (arg + 1 >= argc) {
+         usage();
+      }
+      const char *value = argv[++arg];
+      if (!strcmp(option, "-w")) {
+         for (const char *c = value; *c; ) {
+            workers.push_back((unsigned) strtoul(c, (char **) &c, 10));
+            if (*c == ',') {
+               c++;
+            } else if (*c) {
+               usage();
+            }
+         }
+      } else if (!strcmp(option, "-l")) {
+         config.level = (uint8_t) atoi(value);
+      } else if (!strcmp(option, "-n")) {
+         config.nodes = (unsigned) atoi(value);
+      } else if (!strcmp(option, "-W")) {
+         config.window = (uint32_t) atoi(value);
+      } else if (!strcmp(option, "-r")) {
+         rate = atof(value);
+      } else if (!strcmp(option, "-u")) {
+         port = atoi(value);
+      } else if (!strcmp(option, "-g")) {
+         if (sscanf(value, "%u,%u", &loadNodes, &loadSeconds) < 1) {
+            usage();
+         }
+      } else {
+         usage();
+      }
+   }
+   if (workers.empty()) {
+      workers.push_back(config.workers);
+   }
+
+   //synthetic load, once per worker count
+   if (loadNodes > 0) {
+      std::vector<SyntheticFrame> frames;
+      generate(loadNodes, loadSeconds, frames);
+      printf("%u nodes, %u s: %u frames\n", loadNodes, loadSeconds, (unsigned) frames.size());
+      printf("workers     frames/s   p50 us    p99 us    max us     dup    late     events\n");
+      for (size_t i = 0; i < workers.size(); i++) {
+         config.workers = workers[i];
+         runLoad(frames, config, rate, false);
+      }
+      return 0;
+   }
+
+   config.workers = workers[0];
+   D7SGateway gateway(config, networkEvent);
+   gateway.start();
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   bool ok = true;
+   if (port > 0) {
+      ok = readSocket(gateway, port);
+   } else {
+      if (arg == argc) {
+         usage();
+      }
+      for (; arg < argc; arg++) {
+         ok = readFile(gateway, argv[arg]) && ok;
+      }
+   }
+   gateway.stop();
+   double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   printNodes(gateway);
+   printStats(gateway, elapsed);
+   return ok ? 0 : 1;
+}
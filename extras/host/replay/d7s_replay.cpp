@@ -0,0 +1,282 @@
+//replay recorded PGA/SI time series through the detection, event statistics and alarm code of the library,
+//as fast as the host allows, and print every decision with the time of the sample that caused it
+//build from the library root:
+//   g++ -std=c++11 -O2 -Isrc src/D7SAlarm.cpp src/D7SOnset.cpp src/D7SEventStats.cpp src/D7STelemetry.cpp extras/host/replay/d7s_replay.cpp -o d7s_replay
+//usage:
+//   ./d7s_replay [options] file... (- = stdin)
+//   -b            the inputs are binary (see below), otherwise CSV
+//   -o out.bin    also write the samples in the binary format (to convert a CSV catalog once)
+//   -q            print only the summary of every file
+//   -t pga        PGA of a strong reading [mm/s^2] (default D7S_ALARM_THRESHOLD)
+//   -n readings   consecutive strong readings that raise the alarm (default D7S_ALARM_READINGS)
+//   -w sta,lta,on,off,min   onset detector: windows [samples], ratios [x16], LTA floor [mm/s^2] (default for 100 ms samples)
+//inputs:
+//   CSV     one sample per line: time [ms], SI [mm/s], PGA [mm/s^2] and optionally the d7s STATE,
+//           lines not starting with a digit (headers, comments) are skipped
+//   binary  telemetry frames (D7STelemetry.h) each preceded by its length byte, the same frames the nodes send
+//every file is a separate recording: the detector, the alarm and the statistics restart
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <chrono>
+
+#include "D7SAlarm.h"
+#include "D7SEventStats.h"
+#include "D7SIntensity.h"
+#include "D7STelemetry.h"
+
+#define STATE_EARTHQUAKE 1 //NORMAL_MODE_NOT_IN_STANBY: the d7s is processing an earthquake
+
+//options
+static bool binary = false;
+static bool quiet = false;
+static uint16_t threshold = D7S_ALARM_THRESHOLD;
+static uint8_t readings = D7S_ALARM_READINGS;
+static uint16_t onsetConfig[5] = {D7S_ONSET_STA_WINDOW, D7S_ONSET_LTA_WINDOW, D7S_ONSET_ON_RATIO, D7S_ONSET_OFF_RATIO, D7S_ONSET_MIN_LEVEL};
+static FILE *output = NULL;
+
+//sample source, streamed: a CSV line or a binary frame at a time
+class Reader {
+
+   public:
+
+      Reader(FILE *file) {
+         _file = file;
+         _pending = false;
+         _line = 0;
+      }
+
+      //read the next sample, false at the end of the input
+      bool next(D7STelemetrySample &sample) {
+         return binary ? nextFrameSample(sample) : nextLine(sample);
+      }
+
+      //number of malformed lines or frames skipped
+      uint32_t errors = 0;
+
+   private:
+
+      bool nextLine(D7STelemetrySample &sample) {
+         char line[256];
+         while (fgets(line, sizeof(line), _file)) {
+            _line++;
+            if (!isdigit((unsigned char) line[0])) {
+               continue;
+            }
+            unsigned long time, si, pga, state = 0;
+            int fields = sscanf(line, "%lu , %lu , %lu , %lu", &time, &si, &pga, &state);
+            if (fields < 3 || si > 0xFFFF || pga > 0xFFFF) {
+               fprintf(stderr, "line %u: malformed sample\n", (unsigned) _line);
+               errors++;
+               continue;
+            }
+            sample.sequence = _line;
+            sample.timestamp = (uint32_t) time;
+            sample.si = (uint16_t) si;
+            sample.pga = (uint16_t) pga;
+            sample.state = (uint8_t) state;
+            sample.intensity = d7sIntensity(sample.si, sample.pga);
+            return true;
+         }
+         return false;
+      }
+
+      bool nextFrameSample(D7STelemetrySample &sample) {
+         while (true) {
+            if (_pending && _decoder.next(sample)) {
+               return true;
+            }
+            _pending = false;
+            int length = fgetc(_file);
+            if (length == EOF) {
+               return false;
+            }
+            if (fread(_frame, 1, length, _file) != (size_t) length) {
+               fprintf(stderr, "truncated frame\n");
+               errors++;
+               return false;
+            }
+            if (!_decoder.begin(_frame, length)) {
+               fprintf(stderr, "invalid frame (%d bytes)\n", length);
+               errors++;
+               continue;
+            }
+            _pending = true;
+         }
+      }
+
+      FILE *_file;
+      uint32_t _line;
+      uint8_t _frame[256];
+      D7STelemetryDecoder _decoder;
+      bool _pending;
+};
+
+//binary output: frames of samples with their length byte
+class Writer {
+
+   public:
+
+      Writer() : _encoder(0) {
+      }
+
+      void add(const D7STelemetrySample &sample) {
+         if (!_encoder.add(sample)) {
+            flush();
+            _encoder.add(sample);
+         }
+      }
+
+      void flush() {
+         if (_encoder.count() == 0) {
+            return;
+         }
+         uint8_t length;
+         const uint8_t *frame = _encoder.finish(length);
+         fputc(length, output);
+         fwrite(frame, 1, length, output);
+         _encoder.reset();
+      }
+
+   private:
+
+      D7STelemetryEncoder _encoder;
+};
+
+//totals over all the files
+static uint64_t totalSamples = 0;
+static uint64_t totalRecorded = 0; //[ms]
+static uint32_t totalEvents = 0;
+static uint32_t totalAlarms = 0;
+
+static void printStats(const D7SEventStats &stats) {
+   printf("           %u ms, %u samples, peak pga=%u mm/s^2 at +%u ms, peak si=%u mm/s at +%u ms, rms pga=%u, rms si=%u, intensity %u\n", (unsigned) stats.duration, (unsigned) stats.samples, stats.peakPGA, (unsigned) (stats.peakPGATime - stats.start), stats.peakSI, (unsigned) (stats.peakSITime - stats.start), stats.rmsPGA, stats.rmsSI, stats.maxIntensity);
+   printf("           at or above intensity:");
+   for (uint8_t level = 1; level <= stats.maxIntensity && level < D7S_STATS_LEVELS; level++) {
+      printf(" %u:%ums", level, (unsigned) stats.timeAbove[level]);
+   }
+   printf("\n");
+}
+
+//replay one recording
+static bool replay(const char *name, FILE *file, Writer &writer) {
+   Reader reader(file);
+   D7SAlarm alarm(threshold, readings);
+   alarm.getOnset().configure(onsetConfig[0], onsetConfig[1], onsetConfig[2], onsetConfig[3], onsetConfig[4]);
+   D7SEventAccumulator event;
+
+   D7STelemetrySample sample;
+   uint32_t samples = 0, events = 0, alarms = 0;
+   uint32_t first = 0, last = 0;
+   while (reader.next(sample)) {
+      if (samples++ == 0) {
+         first = sample.timestamp;
+      }
+      last = sample.timestamp;
+      if (output != NULL) {
+         writer.add(sample);
+      }
+
+      uint8_t decisions = alarm.update(sample.state == STATE_EARTHQUAKE, sample.pga);
+      if (decisions & D7S_ALARM_DETECTED) {
+         event.begin(sample.timestamp);
+         events++;
+      }
+      event.add(sample.timestamp, sample.si, sample.pga);
+      if (decisions & D7S_ALARM_ENDED) {
+         event.end(sample.timestamp);
+      }
+      if (decisions & D7S_ALARM_RAISED) {
+         alarms++;
+      }
+
+      if (decisions && !quiet) {
+         printf("[%10u ms] pga=%5u si=%5u state=%u sta/lta=%2u.%02u%s%s%s%s\n", (unsigned) sample.timestamp, sample.pga, sample.si, sample.state, alarm.getOnset().getRatio() / 16, (alarm.getOnset().getRatio() % 16) * 100 / 16, decisions & D7S_ALARM_DETECTED ? " DETECTED" : "", decisions & D7S_ALARM_RAISED ? " ALARM_RAISED" : "", decisions & D7S_ALARM_CLEARED ? " ALARM_CLEARED" : "", decisions & D7S_ALARM_ENDED ? " ENDED" : "");
+         if (decisions & D7S_ALARM_ENDED) {
+            printStats(event.getStats());
+         }
+      }
+   }
+   //an earthquake still going at the end of the recording
+   if (event.isActive()) {
+      event.end(last);
+      if (!quiet) {
+         printf("[%10u ms] end of the recording during an earthquake\n", (unsigned) last);
+         printStats(event.getStats());
+      }
+   }
+
+   printf("%s: %u samples over %u s, %u earthquakes, %u alarms, %u errors\n", name, (unsigned) samples, (unsigned) ((last - first) / 1000), (unsigned) events, (unsigned) alarms, (unsigned) reader.errors);
+   totalSamples += samples;
+   totalRecorded += last - first;
+   totalEvents += events;
+   totalAlarms += alarms;
+   return reader.errors == 0;
+}
+
+static void usage() {
+   fprintf(stderr, "usage: d7s_replay [-b] [-q] [-o out.bin] [-t pga] [-n readings] [-w sta,lta,on,off,min] file...\n");
+   exit(2);
+}
+
+int main(int argc, char **argv) {
+   int arg = 1;
+   for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++) {
+      const char *option = argv[arg];
+      if (!strcmp(option, "-b")) {
+         binary = true;
+      } else if (!strcmp(option, "-q")) {
+         quiet = true;
+      } else if (!strcmp(option, "-o") && arg + 1 < argc) {
+         output = fopen(argv[++arg], "wb");
+         if (output == NULL) {
+            perror(argv[arg]);
+            return 1;
+         }
+      } else if (!strcmp(option, "-t") && arg + 1 < argc) {
+         threshold = (uint16_t) atoi(argv[++arg]);
+      } else if (!strcmp(option, "-n") && arg + 1 < argc) {
+         readings = (uint8_t) atoi(argv[++arg]);
+      } else if (!strcmp(option, "-w") && arg + 1 < argc) {
+         unsigned values[5];
+         if (sscanf(argv[++arg], "%u,%u,%u,%u,%u", &values[0], &values[1], &values[2], &values[3], &values[4]) != 5) {
+            usage();
+         }
+         for (int i = 0; i < 5; i++) {
+            onsetConfig[i] = (uint16_t) values[i];
+         }
+      } else {
+         usage();
+      }
+   }
+   if (arg == argc) {
+      usage();
+   }
+
+   bool ok = true;
+   Writer writer;
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   for (; arg < argc; arg++) {
+      bool standardInput = !strcmp(argv[arg], "-");
+      FILE *file = standardInput ? stdin : fopen(argv[arg], binary ? "rb" : "r");
+      if (file == NULL) {
+         perror(argv[arg]);
+         ok = false;
+         continue;
+      }
+      ok = replay(argv[arg], file, writer) && ok;
+      if (!standardInput) {
+         fclose(file);
+      }
+   }
+   double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   if (output != NULL) {
+      writer.flush();
+      fclose(output);
+   }
+
+   printf("total: %llu samples, %u earthquakes, %u alarms in %.3f s: %.0f samples/s, %.0fx real time\n", (unsigned long long) totalSamples, (unsigned) totalEvents, (unsigned) totalAlarms, elapsed, elapsed > 0 ? totalSamples / elapsed : 0, elapsed > 0 ? totalRecorded / 1000.0 / elapsed : 0);
+   return ok ? 0 : 1;
+}
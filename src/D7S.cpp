@@ -1,175 +1,1819 @@
-#ifndef D7S_H
-#define D7S_H
-
-#include <Arduino.h>
-#include <Wire.h>
-
-// If the board is Fishino32 then we need to fix I2C interrupts priority
-#if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
-   // Include fix file
-   #include "../utils/Fishino32.h"
-   // Define the new Wire instance to use
-   #define WireD7S _Wire
-#else 
-   #define WireD7S Wire
+#include "D7S.h"
+
+#if defined(D7S_TRACE)
+//instances numbered for the trace
+uint8_t D7SClass::_traceInstances = 0;
 #endif
 
-//--- ADDRESS ---
-#define D7S_ADDRESS 0x55 //D7S address on the I2C bus
+//public method charged in the trace records
+#ifndef D7S_DISABLE_STATS
+   #define D7S_TRACE_API currentApi()
+#else
+   #define D7S_TRACE_API D7S_API_NONE
+#endif
 
-//--- DEBUG ----
-//comment this line to disable all debug information
-//#define DEBUG
+#ifndef D7S_DISABLE_STATS
+//innermost public method scope of each task
+#if defined(ESP32) || !defined(ARDUINO)
+thread_local D7SApiScope *D7SApiScope::_current = NULL;
+#else
+D7SApiScope *D7SApiScope::_current = NULL;
+#endif
+#endif
 
+#if !defined(D7S_INTERRUPT_ARG)
+//instances that receive the interrupts of the slot isrs
+D7SClass *D7SClass::_interruptSlots[D7S_MAX_INSTANCES]; //static storage, starts all NULL
+#endif
 
-//d7s state
-typedef enum d7s_status {
-   NORMAL_MODE = 0x00,
-   NORMAL_MODE_NOT_IN_STANBY = 0x01, //earthquake in progress
-   INITIAL_INSTALLATION_MODE = 0x02,
-   OFFSET_ACQUISITION_MODE = 0x03,
-   SELFTEST_MODE = 0x04
-};
+#if defined(ARDUINO)
+//transport of the Wire constructors when every slot of the table is taken: every access fails as an unanswered address
+class D7SMissingTransport : public D7STransport {
 
-//d7s axis settings
-typedef enum d7s_axis_settings {
-   FORCE_YZ = 0x00,
-   FORCE_XZ = 0x01,
-   FORXE_XY = 0x02,
-   AUTO_SWITCH = 0x03,
-   SWITCH_AT_INSTALLATION = 0x04 
-};
+   public:
 
-//axis state
-typedef enum d7s_axis_state {
-   AXIS_YZ = 0x00,
-   AXIS_XZ = 0x01,
-   AXIS_XY = 0x02
+      void begin() {}
+      void setClock(uint32_t clock) { (void) clock; }
+      void setTimeout(uint16_t timeout) { (void) timeout; }
+      uint8_t write(uint8_t address, const uint8_t *data, uint8_t len, bool stop) { (void) address; (void) data; (void) len; (void) stop; return D7S_BUS_NACK_ADDRESS; }
+      uint8_t read(uint8_t address, uint8_t *data, uint8_t len) { (void) address; (void) data; (void) len; return 0; }
 };
 
-//d7s threshold settings
-typedef enum d7s_threshold {
-   THRESHOLD_HIGH = 0x00,
-   THRESHOLD_LOW = 0x01
-};
+//transport of a TwoWire bus, built the first time the bus is used (the pins of the first instance win)
+//the table is a function static, so it is ready even for instances constructed before the globals of this file
+D7STransport *D7SClass::wireTransport(TwoWire &wire, int sda, int scl) {
+   static D7SWireTransport transports[D7S_MAX_WIRES];
+   static D7SMissingTransport missing;
+   for (uint8_t i = 0; i < D7S_MAX_WIRES; i++) {
+      if (transports[i].getWire() == &wire) {
+         return &transports[i];
+      }
+      if (transports[i].getWire() == NULL) {
+         transports[i].attach(wire, sda, scl);
+         return &transports[i];
+      }
+   }
+   //more buses than D7S_MAX_WIRES
+   return &missing;
+}
+#endif
 
-//message status (selftes, offset acquisition)
-typedef enum d7s_mode_status {
-   D7S_OK = 0,
-   D7S_ERROR = 1
-};
+//CONSTRUCTOR/DESTROYER
+#if defined(ARDUINO)
+D7SClass::D7SClass() {
+   _transport = wireTransport(WireD7S, -1, -1);
+   init();
+}
 
-//events handled externaly by the using using an handler (the d7s int1, int2 must be connected to interrupt pin)
-typedef enum d7s_interrupt_event {
-   START_EARTHQUAKE = 0, //INT 2
-   END_EARTHQUAKE = 1, //INT 2
-   SHUTOFF_EVENT = 2, //INT 1
-   COLLAPSE_EVENT = 3 //INT 1
-};
+D7SClass::D7SClass(TwoWire &wire, int sda, int scl) {
+   _transport = wireTransport(wire, sda, scl);
+   init();
+}
 
+D7SClass::D7SClass(D7STransport &transport) {
+   _transport = &transport;
+   init();
+}
+#else
+D7SClass::D7SClass(D7STransport &transport) {
+   _transport = &transport;
+   init();
+}
+#endif
 
-//class D7S
-class D7SClass {
+D7SClass::~D7SClass() {
+   #if defined(ESP32)
+      stopAcquisition();
+   #endif
+   //no interrupt must reach this instance anymore
+   if (_int1Enabled) {
+      detachInterrupt(digitalPinToInterrupt(_pinINT1));
+   }
+   if (_int2Enabled) {
+      detachInterrupt(digitalPinToInterrupt(_pinINT2));
+   }
+   #if !defined(D7S_INTERRUPT_ARG)
+      if (_interruptSlot >= 0) {
+         _interruptSlots[_interruptSlot] = NULL;
+      }
+   #endif
+}
 
-   public: 
+//reset the state of the instance
+void D7SClass::init() {
+   //reset the subscribers and the handler array
+   for (int i = 0; i < 4; i++) {
+      _subscriberCount[i] = 0;
+      _handlers[i] = NULL;
+   }
+   _recordHandler = NULL;
+   _statsHandler = NULL;
 
-      //--- CONSTRUCTOR/DESTROYER ---
-      D7SClass(); //constructor
+   _events = 0;
 
-      //--- BEGIN ---
-      void begin(); //used to initialize Wire
+   //interrupt handling is disabled until startInterruptHandling()
+   _interruptEnabled = 0;
+   _interruptHead = 0;
+   _interruptTail = 0;
+   _droppedInterrupts = 0;
+   _pinINT1 = 0;
+   _int1Enabled = 0;
+   _pinINT2 = 0;
+   _int2Enabled = 0;
+   #if !defined(D7S_INTERRUPT_ARG)
+      _interruptSlot = -1;
+   #endif
+   _earthquakeActive = 0;
+   _modeInProgress = 0;
 
-      //--- STATUS ---
-      d7s_status getState(); //return the currect state
-      d7s_axis_state getAxisInUse(); //return the current axis in use
+   _capture = NULL;
+   memset(&_eventRecord, 0, sizeof(_eventRecord));
+   _sampleBusTime = 0;
 
-      //--- SETTINGS ---
-      void setThreshold(d7s_threshold threshold); //change the threshold in use
-      void setAxis(d7s_axis_settings axisMode); //change the axis selection mode
+   _operation = D7S_OPERATION_NONE;
+   _operationStatus = D7S_OPERATION_IDLE;
+   _operationCallback = NULL;
+   _operationContext = NULL;
+   _operationStart = 0;
+   _operationTimeout = 0;
+   _operationLastPoll = 0;
+   _operationEntered = 0;
 
-      //--- LASTEST DATA ---
-      float getLastestPGV(uint8_t index); //get the lastest PGV at specified index (up to 5) [m/s]
-      float getLastestPGA(uint8_t index); //get the lastest PGA at specified index (up to 5) [m/s^2]
+   #if defined(ESP32)
+      _acquisitionTask = NULL;
+      _acquisitionOwner = NULL;
+      _acquisitionRunning = 0;
+      _acquisitionPeriod = 0;
+   #endif
 
-      //--- INSTANTANEUS DATA ---
-      float getInstantaneusPGV(); //get instantaneus PGV (during an earthquake) [m/s]
-      float getInstantaneusPGA(); //get instantaneus PGA (during an earthquake) [m/s^2]
-      uint8_t getIntensity(); //get the intensity of the earthquake
+   //PHIVOLCS until setIntensityScale()
+   _intensityScale = D7S_SCALE_PHIVOLCS;
 
-      //--- CLEAR MEMORY ---
-      void clearEarthquakeData(); //delete both the lastest data and the ranked data
-      void clearInstallationData(); //delete initializzazion data
-      void clearLastestOffsetData(); //delete offset data
-      void clearSelftestData(); //delete selftest data
-      void clearAllData(); //delete all data
+   //empty register cache
+   _cacheWindow = D7S_DEFAULT_CACHE_WINDOW;
+   _ctrlShadow = 0;
+   invalidateCache();
 
-      //--- INITIALIZATION ---
-      void initialize(); //initialize the d7s (start the initial installation mode)
+   _lastLatency = 0;
+   _lastStatus = D7S_BUS_OK;
 
-      //--- SELFTEST ---
-      void selftest(); //trigger self-diagnostic test
-      d7s_mode_status getSelftestResult(); //return the result of self-diagnostic test (OK/ERROR)
+   //default retry policy
+   _busRetries = D7S_DEFAULT_RETRIES;
+   _busBackoff = D7S_DEFAULT_BACKOFF;
+   _busTimeout = D7S_DEFAULT_TIMEOUT;
 
-      //--- OFFSET ACQUISITION ---
-      void acquireOffset(); //trigger offset acquisition
-      d7s_mode_status getAcquireOffsetResult(); //return the result of offset acquisition test (OK/ERROR)
+   #if defined(D7S_TRACE)
+      _traceId = _traceInstances++;
+   #endif
 
-      //--- SHUTOFF/COLLAPSE EVENT ---
-      //after each earthquakes it's important to reset the events calling resetEvents() to prevent polluting the new data with the old one
-      uint8_t isInCollapse(); //return true if the collapse condition is met (it's the sencond bit of _events)
-      uint8_t isInShutoff(); //return true if the shutoff condition is met (it's the first bit of _events)
-      void resetEvents(); //reset shutoff/collapse events
+   //the lock of the transport, unless a shared one is set
+   _busLock = &_transport->getLock();
+   _busLockTimeout = D7S_BUS_LOCK_TIMEOUT;
 
-      //--- EARTHQUAKE EVENT ---
-      uint8_t isEarthquakeOccuring(); //return true if an earthquake is occuring
+   //reset the counters
+   resetBusCounters();
+   #ifndef D7S_DISABLE_STATS
+      resetBusStats();
+   #endif
 
-      //--- READY STATE ---
-      uint8_t isReady();
+}
 
-      //--- INTERRUPT ---
-      void enableInterruptINT1(uint8_t pin); //enable interrupt INT1 on specified pin
-      void enableInterruptINT2(uint8_t pin); //enable interrupt INT2 on specified pin
-      void startInterruptHandling(); //start interrupt handling
-      void stopInterruptHandling(); //stop interrupt handling
-      void registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) ()); //assing the handler to the specific event
-      void registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) (float, float, float)); //assing the handler to the specific event
+//used to initialize Wire
+void D7SClass::begin(uint32_t clock) {
+   //begin Wire
+   _transport->begin();
+   //set the bus clock
+   setBusClock(clock);
+   //apply the deadline to Wire too
+   setBusTimeout(_busTimeout);
+}
 
-   private:
-      //handler array (it cointaint the pointer to the user defined array)
-      void (*_handlers[4]) ();
+//change the i2c bus clock (D7S_I2C_STANDARD_MODE or D7S_I2C_FAST_MODE)
+void D7SClass::setBusClock(uint32_t clock) {
+   _transport->setClock(clock);
+}
 
-      //variable to track event (first bit => SHUTOFF, second bit => COLLAPSE)
-      uint8_t _events;
+//change the retry policy (retries after the first attempt, base backoff doubled at every retry [us])
+void D7SClass::setBusRetries(uint8_t retries, uint16_t backoff) {
+   _busRetries = retries;
+   _busBackoff = backoff;
+}
 
-      //enable interrupt handling
-      uint8_t _interruptEnabled;
+//change the deadline of a register access, retries included [ms]
+void D7SClass::setBusTimeout(uint16_t timeout) {
+   _busTimeout = timeout;
+   //bound also the time the bus can spend on a single transfer (e.g. clock stretching of a stuck sensor)
+   _transport->setTimeout(timeout);
+}
 
-      //--- READ ---
-      uint8_t read8bit(uint8_t regH, uint8_t regL); //read 8 bit from the specified register
-      uint16_t read16bit(uint8_t regH, uint8_t regL); //read 16 bit from the specified register
+//return the status of the last register access
+d7s_bus_status D7SClass::getLastBusStatus() {
+   return _lastStatus;
+}
 
-      //--- WRITE ---
-      void write8bit(uint8_t regH, uint8_t regL, uint8_t val); //write 8 bit to the register specified
+//return the number of retries since the last reset
+uint32_t D7SClass::getBusRetries() {
+   return _busRetryCount;
+}
 
-      //--- READ EVENTS ---
-      void readEvents(); //read the event (SHUTOFF/COLLAPSE) from the EVENT register
+//return the number of failed register accesses since the last reset
+uint32_t D7SClass::getBusFailures() {
+   return _busFailureCount;
+}
 
-      //--- EVENT HANDLER ---
-      void int1(); //handle the INT1 events
-      void int2(); //handle the INT2 events
+//reset the retries/failures counters
+void D7SClass::resetBusCounters() {
+   _busRetryCount = 0;
+   _busFailureCount = 0;
+}
 
-      //--- ISR HANDLER ---
-      static void isr1(); //it handle the FALLING event that occur to the INT1 D7S pin (glue routine)
-      static void isr2(); //it handle the CHANGE event thant occur to the INT2 D7S pin (glue routine)
+//transport used to talk with the d7s
+D7STransport &D7SClass::getTransport() {
+   return *_transport;
+}
 
-      // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
-      // as RISING the same pin detaching the previus interrupt
-      #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
-         uint8_t pinINT2;
-      #endif
+//lock of the bus, take it (D7SBusTransaction) to group accesses or to talk to other devices on the same bus
+D7SBusLock &D7SClass::getBusLock() {
+   return *_busLock;
+}
 
-};
+//use a lock shared with other drivers instead of the one of the transport
+void D7SClass::setBusLock(D7SBusLock &lock) {
+   _busLock = &lock;
+}
+
+//change the longest wait for the bus lock [ms]
+void D7SClass::setBusLockTimeout(uint16_t timeout) {
+   _busLockTimeout = timeout;
+}
+
+#ifndef D7S_DISABLE_STATS
+
+//copy the bus statistics (per register block and per public method)
+void D7SClass::getBusStats(D7SBusStats &stats) {
+   D7SBusTransaction transaction(*_busLock, D7S_BUS_PRIORITY_NORMAL, _busLockTimeout);
+   stats = _stats;
+}
+
+//reset the bus statistics
+void D7SClass::resetBusStats() {
+   D7SBusTransaction transaction(*_busLock, D7S_BUS_PRIORITY_NORMAL, _busLockTimeout);
+   memset(&_stats, 0, sizeof(_stats));
+}
+
+//public method the calling task is executing on this instance
+d7s_api D7SClass::currentApi() {
+   return D7SApiScope::current(this);
+}
+
+#endif
+
+//return the duration of the last register access [us]
+uint32_t D7SClass::getLastBusLatency() {
+   return _lastLatency;
+}
+
+//change how long STATE, AXIS_STATE and EVENT are served from the cache [ms] (0 = always read from the d7s)
+void D7SClass::setCacheWindow(uint16_t window) {
+   _cacheWindow = window;
+}
+
+//drop the cached STATE, AXIS_STATE, EVENT and CTRL values
+void D7SClass::invalidateCache() {
+   invalidateCache(D7S_REG_STATE);
+   invalidateCache(D7S_REG_AXIS_STATE);
+   invalidateCache(D7S_REG_EVENT);
+   _ctrlValid = 0;
+}
+
+//drop the cached value of a single register (D7S_REG_STATE, D7S_REG_AXIS_STATE or D7S_REG_EVENT)
+D7S_ISR_ATTR void D7SClass::invalidateCache(uint8_t regL) {
+   if (regL <= D7S_REG_EVENT) {
+      _statusCache[regL].valid = 0;
+   }
+}
+
+//return the currect state
+d7s_status D7SClass::getState() {
+   D7S_API_SCOPE(D7S_API_GET_STATE);
+   //read the STATE register at 0x1000 (from the cache if fresh)
+   return (d7s_status) (readStatusRegister(D7S_REG_STATE).value & 0x07);
+}
+
+//return the currect state
+d7s_axis_state D7SClass::getAxisInUse() {
+   D7S_API_SCOPE(D7S_API_GET_AXIS_IN_USE);
+   //read the AXIS_STATE register at 0x1001 (from the cache if fresh)
+   return (d7s_axis_state) (readStatusRegister(D7S_REG_AXIS_STATE).value & 0x03);
+}
+
+//settings
+//change the threshold in use (0=highly sensitive, 1=normal)
+void D7SClass::setThreshold(d7s_threshold threshold) {
+   D7S_API_SCOPE(D7S_API_SET_THRESHOLD);
+   //check if threshold is valid
+   if (threshold < 0 || threshold > 1) {
+      return;
+   }
+   //read the CTRL register at 0x1004 (only the first time, then the shadow copy is used)
+   D7SResult<uint8_t> ctrl = readCtrl();
+   //do not write back a value we could not read
+   if (!ctrl.ok()) {
+      return;
+   }
+   uint8_t reg = ctrl.value;
+   //new register value with the threshold
+   reg = (((reg >> 4) << 1) | (threshold & 0x01)) << 3;
+   writeCtrl(reg);
+}
+
+//change the axis selection mode
+void D7SClass::setAxis(d7s_axis_settings axisMode) {
+   D7S_API_SCOPE(D7S_API_SET_AXIS);
+   //check if axisMode is valid
+   if (axisMode < 0 or axisMode > 4) {
+      return;
+   }
+   //read the CTRL register at 0x1004 (only the first time, then the shadow copy is used)
+   D7SResult<uint8_t> ctrl = readCtrl();
+   //do not write back a value we could not read
+   if (!ctrl.ok()) {
+      return;
+   }
+   uint8_t reg = ctrl.value;
+   //new register value with the threshold
+   reg = (axisMode << 4) | (reg & 0x0F);
+   //update register
+   writeCtrl(reg);
+}
+
+//get the lastest pgv at specified index (up to 5) [m/s]
+float D7SClass::getLastestPGV(uint8_t index) {
+   return ((float) getLastestPGVRaw(index)) / 1000;
+}
+
+//get the lastest PGA at specified index (up to 5) [m/s^2]
+float D7SClass::getLastestPGA(uint8_t index) {
+   return ((float) getLastestPGARaw(index)) / 1000;
+}
+
+//get the lastest temperature at specified index (up to 5) [C]
+float D7SClass::getLastestTemperature(uint8_t index) {
+   return ((float) getLastestTemperatureRaw(index)) / 10;
+}
+
+//get the lastest pgv at specified index (up to 5) [mm/s]
+uint16_t D7SClass::getLastestPGVRaw(uint8_t index) {
+   D7S_API_SCOPE(D7S_API_GET_LASTEST_PGV);
+   //check if the index is in bound
+   if (index > 4) {
+      return 0;
+   }
+   //return the value
+   return read16bit(0x30 + index, 0x08).value;
+}
+
+//get the lastest PGA at specified index (up to 5) [mm/s^2]
+uint16_t D7SClass::getLastestPGARaw(uint8_t index) {
+   D7S_API_SCOPE(D7S_API_GET_LASTEST_PGA);
+   //check if the index is in bound
+   if (index > 4) {
+      return 0;
+   }
+   //return the value
+   return read16bit(0x30 + index, 0x0A).value;
+}
+
+//get the lastest temperature at specified index (up to 5) [0.1 C]
+int16_t D7SClass::getLastestTemperatureRaw(uint8_t index) {
+   D7S_API_SCOPE(D7S_API_GET_LASTEST_TEMPERATURE);
+   //check if the index is in bound
+   if (index > 4) {
+      return 0;
+   }
+   //return the value (signed)
+   return (int16_t) read16bit(0x30 + index, 0x06).value;
+}
+
+//get the whole lastest record at specified index (up to 5) in one read
+D7SRecord D7SClass::getLatestRecord(uint8_t index) {
+   D7S_API_SCOPE(D7S_API_GET_LATEST_RECORD);
+   //check if the index is in bound
+   if (index > 4) {
+      D7SRecord empty = {};
+      return empty;
+   }
+   //lastest records are at 0x3000-0x3400
+   D7SRecord record;
+   readRecord(0x30 + index, record);
+   return record;
+}
+
+//get the whole ranked record at specified position (up to 5) in one read
+D7SRecord D7SClass::getRankedRecord(uint8_t index) {
+   D7S_API_SCOPE(D7S_API_GET_RANKED_RECORD);
+   //check if the index is in bound
+   if (index > 4) {
+      D7SRecord empty = {};
+      return empty;
+   }
+   //ranked records are at 0x3500-0x3900
+   D7SRecord record;
+   readRecord(0x35 + index, record);
+   return record;
+}
+
+//read all the lastest and ranked records (10 block reads)
+d7s_bus_status D7SClass::readHistory(D7SHistory &history) {
+   D7S_API_SCOPE(D7S_API_READ_HISTORY);
+   //the whole dump in one ownership window
+   D7SBusTransaction transaction(*_busLock, D7S_BUS_PRIORITY_NORMAL, _busLockTimeout);
+   if (!transaction.ok()) {
+      return D7S_BUS_LOCKED;
+   }
+   d7s_bus_status status = D7S_BUS_OK;
+   history.changed = 0;
+   history.reads = 0;
+
+   for (uint8_t i = 0; i < D7S_HISTORY_SLOTS; i++) {
+      D7SRecord latest, ranked;
+      d7s_bus_status latestStatus = readRecord(0x30 + i, latest);
+      d7s_bus_status rankedStatus = readRecord(0x35 + i, ranked);
+      history.reads += 2;
+      if (latestStatus != D7S_BUS_OK || rankedStatus != D7S_BUS_OK) {
+         status = latestStatus != D7S_BUS_OK ? latestStatus : rankedStatus;
+      }
+      //track the slots that changed since the previous content of history
+      if (!history.valid || !sameRecord(history.latest[i], latest)) {
+         history.changed |= 1 << i;
+      }
+      if (!history.valid || !sameRecord(history.ranked[i], ranked)) {
+         history.changed |= 1 << (D7S_HISTORY_SLOTS + i);
+      }
+      history.latest[i] = latest;
+      history.ranked[i] = ranked;
+   }
+
+   //a partial dump cannot be the base of an incremental one
+   history.valid = status == D7S_BUS_OK;
+   return status;
+}
+
+//re-read only the records changed since the previous dump of history
+//every earthquake shifts the lastest records down by one and inserts its record in the ranked ones by SI, so:
+//- the newest lastest record tells if something changed (one block read when nothing did)
+//- the previous newest record is searched in the following slots to know how many earthquakes were added,
+//  the older records are shifted in memory instead of being read again
+//- ranked records are re-read only from the first slot where one of the new earthquakes can be inserted
+//if the previous newest record is not found (more than 4 earthquakes, or the data was cleared) everything is read
+d7s_bus_status D7SClass::updateHistory(D7SHistory &history) {
+   D7S_API_SCOPE(D7S_API_UPDATE_HISTORY);
+   D7SBusTransaction transaction(*_busLock, D7S_BUS_PRIORITY_NORMAL, _busLockTimeout);
+   if (!transaction.ok()) {
+      return D7S_BUS_LOCKED;
+   }
+
+   //no base to compare with
+   if (!history.valid) {
+      return readHistory(history);
+   }
+
+   D7SRecord latest[D7S_HISTORY_SLOTS];
+   d7s_bus_status status;
+   history.changed = 0;
+   history.reads = 0;
+
+   //nothing changed if the newest record is the same
+   status = readRecord(0x30, latest[0]);
+   history.reads++;
+   if (status != D7S_BUS_OK) {
+      history.valid = 0;
+      return status;
+   }
+   if (sameRecord(latest[0], history.latest[0])) {
+      return D7S_BUS_OK;
+   }
+
+   //count the new earthquakes: the previous newest record moved to slot added
+   uint8_t added = 1;
+   while (added < D7S_HISTORY_SLOTS) {
+      status = readRecord(0x30 + added, latest[added]);
+      history.reads++;
+      if (status != D7S_BUS_OK) {
+         history.valid = 0;
+         return status;
+      }
+      if (sameRecord(latest[added], history.latest[0])) {
+         break;
+      }
+      added++;
+   }
+
+   //first ranked slot that can change (with equal SI the new record may go either side, take the earlier slot)
+   uint8_t firstRanked = D7S_HISTORY_SLOTS;
+   if (added == D7S_HISTORY_SLOTS) {
+      //previous newest record not found, every lastest slot was read
+      firstRanked = 0;
+   } else {
+      //shift the older records, then store the new ones
+      for (uint8_t i = D7S_HISTORY_SLOTS - 1; i >= added; i--) {
+         latest[i] = history.latest[i - added];
+      }
+      for (uint8_t i = 0; i < added; i++) {
+         uint8_t slot = 0;
+         while (slot < firstRanked && latest[i].si < history.ranked[slot].si) {
+            slot++;
+         }
+         firstRanked = slot;
+      }
+   }
+
+   for (uint8_t i = 0; i < D7S_HISTORY_SLOTS; i++) {
+      if (!sameRecord(history.latest[i], latest[i])) {
+         history.changed |= 1 << i;
+      }
+      history.latest[i] = latest[i];
+   }
+
+   //re-read the ranked records from the first slot that can change
+   for (uint8_t i = firstRanked; i < D7S_HISTORY_SLOTS; i++) {
+      D7SRecord ranked;
+      status = readRecord(0x35 + i, ranked);
+      history.reads++;
+      if (status != D7S_BUS_OK) {
+         history.valid = 0;
+         return status;
+      }
+      if (!sameRecord(history.ranked[i], ranked)) {
+         history.changed |= 1 << (D7S_HISTORY_SLOTS + i);
+      }
+      history.ranked[i] = ranked;
+   }
+
+   return D7S_BUS_OK;
+}
+
+//get instantaneus PGV (during an earthquake) [m/s]
+float D7SClass::getInstantaneusPGV() {
+   return ((float) getInstantaneusPGVRaw()) / 1000;
+}
+
+//get instantaneus PGA (during an earthquake) [m/s^2]
+float D7SClass::getInstantaneusPGA() {
+   return ((float) getInstantaneusPGARaw()) / 1000;
+}
+
+//get instantaneus PGV (during an earthquake) [mm/s]
+uint16_t D7SClass::getInstantaneusPGVRaw() {
+   D7S_API_SCOPE(D7S_API_GET_INSTANTANEUS_PGV);
+   //return the value
+   return read16bit(0x20, 0x00).value;
+}
+
+//get instantaneus PGA (during an earthquake) [mm/s^2]
+uint16_t D7SClass::getInstantaneusPGARaw() {
+   D7S_API_SCOPE(D7S_API_GET_INSTANTANEUS_PGA);
+   //return the value
+   return read16bit(0x20, 0x02).value;
+}
+
+//change the scale of getIntensity() and of the event statistics
+void D7SClass::setIntensityScale(uint8_t scale) {
+   _intensityScale = scale;
+   _eventStats.setScale(scale);
+}
+
+//return the scale of getIntensity()
+uint8_t D7SClass::getIntensityScale() {
+   return _intensityScale;
+}
+
+//get intensity
+uint8_t D7SClass::getIntensity() {
+   D7S_API_SCOPE(D7S_API_GET_INTENSITY);
+   //read only what the scale needs: PGA (0x2002), SI (0x2000) or both
+   switch (_intensityScale) {
+      case D7S_SCALE_JMA:
+         return d7sIntensityJMA(getInstantaneusPGVRaw());
+      case D7S_SCALE_MMI: {
+         uint8_t data[4] = {0, 0, 0, 0};
+         readBlock(0x20, 0x00, data, 4);
+         return d7sIntensityMMI((data[2] << 8) | data[3], (data[0] << 8) | data[1]);
+      }
+      default:
+         return d7sIntensityPHIVOLCS(getInstantaneusPGARaw());
+   }
+}
+
+//read state, instantaneous SI and PGA together
+D7SSnapshot D7SClass::getSnapshot() {
+   D7S_API_SCOPE(D7S_API_GET_SNAPSHOT);
+   D7SSnapshot snapshot;
+   uint8_t data[4] = {0, 0, 0, 0};
+
+   //the timestamp is taken at the start of the read
+   snapshot.timestamp = millis();
+
+   //STATE and the data in one ownership window, so they describe the same moment
+   D7SBusTransaction transaction(*_busLock, D7S_BUS_PRIORITY_NORMAL, _busLockTimeout);
+   if (!transaction.ok()) {
+      snapshot.state = NORMAL_MODE;
+      snapshot.si = 0;
+      snapshot.pga = 0;
+      snapshot.status = D7S_BUS_LOCKED;
+      return snapshot;
+   }
+
+   //read the STATE register at 0x1000
+   D7SResult<uint8_t> state = readStatusRegister(D7S_REG_STATE);
+   snapshot.state = (d7s_status) (state.value & 0x07);
+   snapshot.status = state.status;
+
+   //read SI (0x2000) and PGA (0x2002) in one sequential read, skipped if the sensor did not answer
+   if (state.ok()) {
+      snapshot.status = readBlock(0x20, 0x00, data, 4);
+   }
+   snapshot.si = (data[0] << 8) | data[1];
+   snapshot.pga = (data[2] << 8) | data[3];
+
+   return snapshot;
+}
+
+//get the instantaneus PGV of a snapshot [m/s]
+float D7SClass::getInstantaneusPGV(const D7SSnapshot &snapshot) {
+   return ((float) snapshot.si) / 1000;
+}
+
+//get the instantaneus PGA of a snapshot [m/s^2]
+float D7SClass::getInstantaneusPGA(const D7SSnapshot &snapshot) {
+   return ((float) snapshot.pga) / 1000;
+}
+
+//get the intensity of a snapshot (no bus access)
+uint8_t D7SClass::getIntensity(const D7SSnapshot &snapshot) {
+   return d7sIntensity(snapshot.si, snapshot.pga, _intensityScale);
+}
+
+//return true if an earthquake was occuring when the snapshot was taken
+uint8_t D7SClass::isEarthquakeOccuring(const D7SSnapshot &snapshot) {
+   return snapshot.state == NORMAL_MODE_NOT_IN_STANBY;
+}
+
+//return true if the d7s was ready when the snapshot was taken
+uint8_t D7SClass::isReady(const D7SSnapshot &snapshot) {
+   return snapshot.status == D7S_BUS_OK && snapshot.state == NORMAL_MODE;
+}
+
+//delete both the lastest data and the ranked data
+void D7SClass::clearEarthquakeData() {
+   D7S_API_SCOPE(D7S_API_CLEAR);
+   //write clear command
+   write8bit(0x10, 0x05, 0x01);
+   //the EVENT register changed
+   invalidateCache(D7S_REG_EVENT);
+}
+
+//delete initializzazion data
+void D7SClass::clearInstallationData() {
+   D7S_API_SCOPE(D7S_API_CLEAR);
+   //write clear command
+   write8bit(0x10, 0x05, 0x08);
+   //the EVENT register changed
+   invalidateCache(D7S_REG_EVENT);
+}
+
+//delete offset data
+void D7SClass::clearLastestOffsetData() {
+   D7S_API_SCOPE(D7S_API_CLEAR);
+   //write clear command
+   write8bit(0x10, 0x05, 0x04);
+   //the EVENT register changed
+   invalidateCache(D7S_REG_EVENT);
+}
+
+//delete selftest data
+void D7SClass::clearSelftestData() {
+   D7S_API_SCOPE(D7S_API_CLEAR);
+   //write clear command
+   write8bit(0x10, 0x05, 0x02);
+   //the EVENT register changed
+   invalidateCache(D7S_REG_EVENT);
+}
+
+//delete all data
+void D7SClass::clearAllData() {
+   D7S_API_SCOPE(D7S_API_CLEAR);
+   //write clear command
+   write8bit(0x10, 0x05, 0x0F);
+   //the EVENT register changed
+   invalidateCache(D7S_REG_EVENT);
+}
+
+//initialize the d7s (start the initial installation mode)
+void D7SClass::initialize() {
+   D7S_API_SCOPE(D7S_API_INITIALIZE);
+   //write INITIAL INSTALLATION MODE command
+   writeMode(0x02);
+}
+
+//start autodiagnostic and resturn the result (OK/ERROR)
+void D7SClass::selftest() {
+   D7S_API_SCOPE(D7S_API_SELFTEST);
+   //write SELFTEST command
+   writeMode(0x04);
+}
+
+//return the result of self-diagnostic test (OK/ERROR)
+d7s_mode_status D7SClass::getSelftestResult() {
+   D7S_API_SCOPE(D7S_API_GET_SELFTEST_RESULT);
+   //return result of the selftest
+   return readModeResult(D7S_OPERATION_SELFTEST).value;
+}
+
+//start offset acquisition and return the rersult (OK/ERROR)
+void D7SClass::acquireOffset() {
+   D7S_API_SCOPE(D7S_API_ACQUIRE_OFFSET);
+   //write OFFSET ACQUISITION MODE command
+   writeMode(0x03);
+}
+
+//return the result of offset acquisition test (OK/ERROR)
+d7s_mode_status D7SClass::getAcquireOffsetResult() {
+   D7S_API_SCOPE(D7S_API_GET_ACQUIRE_OFFSET_RESULT);
+   //return result of the offset acquisition
+   return readModeResult(D7S_OPERATION_ACQUIRE_OFFSET).value;
+}
+
+//write a mode command (INITIAL INSTALLATION 0x02, OFFSET ACQUISITION 0x03, SELFTEST 0x04), return the status of this write
+d7s_bus_status D7SClass::writeMode(uint8_t mode) {
+   //the INT2 edges of the mode are not an earthquake
+   _modeInProgress = _int2Enabled;
+   d7s_bus_status status = write8bit(0x10, 0x03, mode);
+   if (status != D7S_BUS_OK) {
+      //no mode, no INT2 edges to skip
+      _modeInProgress = 0;
+   }
+   //the d7s changes mode, STATE/AXIS_STATE/EVENT will change
+   invalidateCache();
+   return status;
+}
+
+//read the result of a selftest or offset acquisition from EVENT (D7S_ERROR if the read failed)
+D7SResult<d7s_mode_status> D7SClass::readModeResult(d7s_operation operation) {
+   D7SResult<uint8_t> event = readStatusRegister(D7S_REG_EVENT);
+   D7SResult<d7s_mode_status> result;
+   result.status = event.status;
+   if (!event.ok()) {
+      result.value = D7S_ERROR;
+   } else if (operation == D7S_OPERATION_SELFTEST) {
+      result.value = (d7s_mode_status) ((event.value & 0x07) >> 2);
+   } else {
+      result.value = (d7s_mode_status) ((event.value & 0x0F) >> 3);
+   }
+   return result;
+}
+
+//after each earthquakes it's important to reset the events calling resetEvents() to prevent polluting the new data with the old one
+//return true if the collapse condition is met (it's the sencond bit of _events)
+uint8_t D7SClass::isInCollapse() {
+   D7S_API_SCOPE(D7S_API_IS_IN_COLLAPSE);
+   //updating the _events variable
+   readEvents();
+   //return the second bit of _events
+   return (_events & 0x02) >> 1;
+}
+
+//return true if the shutoff condition is met (it's the first bit of _events)
+uint8_t D7SClass::isInShutoff() {
+   D7S_API_SCOPE(D7S_API_IS_IN_SHUTOFF);
+   //updating the _events variable
+   readEvents();
+   //return the second bit of _events
+   return _events & 0x01;
+}
+
+//reset shutoff/collapse events
+void D7SClass::resetEvents() {
+   D7S_API_SCOPE(D7S_API_RESET_EVENTS);
+   //reset the EVENT register (read to zero-ing it), always on the bus
+   read8bit(0x10, 0x02);
+   invalidateCache(D7S_REG_EVENT);
+   //reset the events variable
+   _events = 0;
+}
+
+//return true if an earthquake is occuring
+uint8_t D7SClass::isEarthquakeOccuring() {
+   D7S_API_SCOPE(D7S_API_IS_EARTHQUAKE_OCCURING);
+   //if D7S is in NORMAL MODE NOT IN STANBY (after the first 4 sec to initial delay) there is an earthquake
+   return getState() == NORMAL_MODE_NOT_IN_STANBY;
+}
+
+uint8_t D7SClass::isReady() {
+   D7S_API_SCOPE(D7S_API_IS_READY);
+   return getState() == NORMAL_MODE;
+}
+
+
+//start initialize/selftest/acquireOffset without blocking (false if another operation is running)
+bool D7SClass::startOperation(d7s_operation operation, uint32_t timeout, d7s_operation_callback callback, void *ctx) {
+   if (_operationStatus == D7S_OPERATION_RUNNING || operation == D7S_OPERATION_NONE) {
+      return false;
+   }
+
+   _operation = operation;
+   _operationCallback = callback;
+   _operationContext = ctx;
+   _operationTimeout = timeout;
+   _operationEntered = 0;
+   _operationStart = millis();
+   _operationLastPoll = _operationStart;
+   _operationStatus = D7S_OPERATION_RUNNING;
+
+   //write the mode command, the status is the one of this write (other tasks may use the bus meanwhile)
+   d7s_bus_status status;
+   switch (operation) {
+      case D7S_OPERATION_INITIALIZE: {
+         D7S_API_SCOPE(D7S_API_INITIALIZE);
+         status = writeMode(0x02);
+         break;
+      }
+      case D7S_OPERATION_SELFTEST: {
+         D7S_API_SCOPE(D7S_API_SELFTEST);
+         status = writeMode(0x04);
+         break;
+      }
+      default: {
+         D7S_API_SCOPE(D7S_API_ACQUIRE_OFFSET);
+         status = writeMode(0x03);
+         break;
+      }
+   }
+   //if the command did not reach the d7s, STATE never leaves NORMAL_MODE and the poll would report a success
+   if (status != D7S_BUS_OK) {
+      finishOperation(D7S_OPERATION_BUS_ERROR);
+      return false;
+   }
+   return true;
+}
+
+//advance the running operation and return its status
+//the d7s leaves NORMAL_MODE while it runs the mode and goes back to it when done, then the result is in EVENT
+d7s_operation_status D7SClass::pollOperation() {
+   //while the acquisition task runs it is the only one advancing the operation, the other tasks just see the status
+   if (_operationStatus != D7S_OPERATION_RUNNING || !isSampler()) {
+      return _operationStatus;
+   }
+   D7S_API_SCOPE(D7S_API_POLL_OPERATION);
+
+   //do not keep the bus busy, STATE changes at most a few times per operation
+   uint32_t now = millis();
+   if (now - _operationLastPoll < D7S_OPERATION_POLL_INTERVAL) {
+      return _operationStatus;
+   }
+   _operationLastPoll = now;
+
+   D7SResult<uint8_t> state = readStatusRegister(D7S_REG_STATE);
+   if (!state.ok()) {
+      //keep trying until the deadline
+      if (now - _operationStart >= _operationTimeout) {
+         return finishOperation(D7S_OPERATION_BUS_ERROR);
+      }
+      return _operationStatus;
+   }
+
+   if ((state.value & 0x07) != NORMAL_MODE) {
+      //still in the mode
+      _operationEntered = 1;
+   } else if (_operationEntered || now - _operationStart >= D7S_OPERATION_START_WINDOW) {
+      //back to normal mode (or the mode was over before we could see it), read the result
+      invalidateCache(D7S_REG_EVENT);
+      D7SResult<d7s_mode_status> result;
+      result.status = D7S_BUS_OK;
+      result.value = D7S_OK;
+      if (_operation != D7S_OPERATION_INITIALIZE) {
+         result = readModeResult(_operation);
+      }
+      if (!result.ok()) {
+         //retry the result at the next poll
+         if (now - _operationStart >= _operationTimeout) {
+            return finishOperation(D7S_OPERATION_BUS_ERROR);
+         }
+         return _operationStatus;
+      }
+      return finishOperation(result.value == D7S_OK ? D7S_OPERATION_DONE : D7S_OPERATION_FAILED);
+   }
+
+   if (now - _operationStart >= _operationTimeout) {
+      return finishOperation(D7S_OPERATION_TIMEOUT);
+   }
+   return _operationStatus;
+}
+
+//return the status of the last operation (no bus access)
+d7s_operation_status D7SClass::getOperationStatus() {
+   return _operationStatus;
+}
+
+//return the last operation started
+d7s_operation D7SClass::getOperation() {
+   return _operation;
+}
+
+//complete the running operation and call its callback
+d7s_operation_status D7SClass::finishOperation(d7s_operation_status status) {
+   _operationStatus = status;
+   if (_operationCallback) {
+      _operationCallback(_operation, status, _operationContext);
+   }
+   return status;
+}
+
+//enable interrupt INT1 on specified pin
+bool D7SClass::enableInterruptINT1(uint8_t pin) {
+   //enable pull up resistor
+   pinMode(pin, INPUT_PULLUP);
+   //attach interrupt (routed to this instance)
+   if (!attachIsr(pin, 1, FALLING)) {
+      return false;
+   }
+   _pinINT1 = pin;
+   _int1Enabled = 1;
+   return true;
+}
+
+//enable interrupt INT2 on specified pin
+bool D7SClass::enableInterruptINT2(uint8_t pin) {
+   //enable pull up resistor
+   pinMode(pin, INPUT_PULLUP);
+   //the isr reads the pin level to tell the start from the end of an earthquake
+   _pinINT2 = pin;
+   // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
+   // as RISING the same pin detaching the previus interrupt
+   #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
+      //attach interrupt (routed to this instance)
+      if (!attachIsr(pin, 2, FALLING)) {
+         return false;
+      }
+   #else
+      //attach interrupt (routed to this instance)
+      if (!attachIsr(pin, 2, CHANGE)) {
+         return false;
+      }
+   #endif
+   _int2Enabled = 1;
+   return true;
+}
+
+//start interrupt handling
+void D7SClass::startInterruptHandling() {
+   //enabling interrupt handling
+   _interruptEnabled = 1;
+}
+
+//stop interrupt handling
+void D7SClass::stopInterruptHandling() {
+   //disabling interrupt handling
+   _interruptEnabled = 0;
+}
+
+//assing the handler to the specific event
+void D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) ()) {
+   //check if event is in bound (it's the index to the handlers array)
+   if (event < 0 || event > 3) {
+      return;
+   }
+   //copy the pointer to the array, the slot is the context of its subscriber (NULL removes it)
+   _handlers[event] = handler;
+   if (handler) {
+      subscribe(event, callHandler, &_handlers[event]);
+   } else {
+      unsubscribe(event, callHandler, &_handlers[event]);
+   }
+}
 
-extern D7SClass D7S;
+void D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) (float, float, float)) {
+   //only END_EARTHQUAKE has arguments
+   if (event != END_EARTHQUAKE) {
+      return;
+   }
+   _recordHandler = handler;
+   if (handler) {
+      subscribe(event, callRecordHandler, &_recordHandler);
+   } else {
+      unsubscribe(event, callRecordHandler, &_recordHandler);
+   }
+}
+
+//assing the handler to END_EARTHQUAKE, it receives the statistics of the earthquake
+void D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) (const D7SEventStats &)) {
+   if (event != END_EARTHQUAKE) {
+      return;
+   }
+   _statsHandler = handler;
+   if (handler) {
+      subscribe(event, callStatsHandler, &_statsHandler);
+   } else {
+      unsubscribe(event, callStatsHandler, &_statsHandler);
+   }
+}
+
+//add a subscriber to the event (false if the table of the event is full)
+//call it while processEvents() is not running (from setup() or from the task that calls processEvents()), never from a subscriber
+bool D7SClass::subscribe(d7s_interrupt_event event, d7s_event_callback callback, void *ctx) {
+   if (event < 0 || event > 3 || callback == NULL) {
+      return false;
+   }
+   D7SSubscriber *subscribers = _subscribers[event];
+   //the same callback and context is subscribed only once
+   for (uint8_t i = 0; i < _subscriberCount[event]; i++) {
+      if (subscribers[i].callback == callback && subscribers[i].ctx == ctx) {
+         return true;
+      }
+   }
+   if (_subscriberCount[event] == D7S_MAX_SUBSCRIBERS) {
+      return false;
+   }
+   subscribers[_subscriberCount[event]].callback = callback;
+   subscribers[_subscriberCount[event]].ctx = ctx;
+   _subscriberCount[event]++;
+   return true;
+}
+
+//remove a subscriber from the event (the others keep their order)
+void D7SClass::unsubscribe(d7s_interrupt_event event, d7s_event_callback callback, void *ctx) {
+   if (event < 0 || event > 3) {
+      return;
+   }
+   D7SSubscriber *subscribers = _subscribers[event];
+   for (uint8_t i = 0; i < _subscriberCount[event]; i++) {
+      if (subscribers[i].callback == callback && subscribers[i].ctx == ctx) {
+         for (uint8_t j = i + 1; j < _subscriberCount[event]; j++) {
+            subscribers[j - 1] = subscribers[j];
+         }
+         _subscriberCount[event]--;
+         return;
+      }
+   }
+}
+
+//do the bus work for the queued interrupts and call the handlers (call it from loop() or from a task, never from an isr)
+uint8_t D7SClass::processEvents() {
+   //the queue has a single consumer
+   if (!isSampler()) {
+      return 0;
+   }
+   D7S_API_SCOPE(D7S_API_PROCESS_EVENTS);
+   uint8_t processed = 0;
+
+   if (_interruptTail == _interruptHead) {
+      return 0;
+   }
+
+   //drain the queue
+   while (_interruptTail != _interruptHead) {
+      D7SEvent payload;
+      bool ready;
+      {
+         //the register reads of an event go before the other users of the bus, if it cannot have it the rest of the queue is kept for the next call
+         D7SBusTransaction transaction(*_busLock, D7S_BUS_PRIORITY_EVENT, _busLockTimeout);
+         if (!transaction.ok()) {
+            return processed;
+         }
+
+         //copy the event before releasing the slot to the isr
+         D7SInterrupt interrupt = _interruptQueue[_interruptTail & (D7S_INTERRUPT_QUEUE_SIZE - 1)];
+         __sync_synchronize();
+         _interruptTail++;
+         processed++;
+
+         //the queue is always drained and the mode/earthquake state always follows INT2,
+         //the handlers are called only if the interrupt handling is enabled
+         if (interrupt.source == 1) {
+            ready = int1(interrupt, payload);
+         } else {
+            ready = int2(interrupt, payload);
+         }
+      }
+
+      //the handlers run after the bus is released, a slow handler does not hold up the other users
+      if (ready) {
+         dispatch(payload);
+      }
+   }
+
+   return processed;
+}
+
+//false if the acquisition task runs and the caller is another task
+//(from startAcquisition() until the task has exited, only the task itself may sample and drain the interrupts)
+bool D7SClass::isSampler() {
+   #if defined(ESP32)
+      if (_acquisitionRunning || _acquisitionTask != NULL) {
+         return xTaskGetCurrentTaskHandle() == _acquisitionOwner;
+      }
+   #endif
+   return true;
+}
+
+//return the number of interrupts waiting for processEvents()
+uint8_t D7SClass::getPendingEvents() {
+   return (uint8_t) (_interruptHead - _interruptTail);
+}
+
+//return the number of interrupts lost because the queue was full
+uint32_t D7SClass::getDroppedEvents() {
+   return _droppedInterrupts;
+}
+
+//take a snapshot and append it to the sample ring
+D7SSnapshot D7SClass::acquireSample() {
+   //the ring, the statistics and the capture have a single producer
+   if (!isSampler()) {
+      D7SSnapshot snapshot;
+      snapshot.state = NORMAL_MODE;
+      snapshot.si = 0;
+      snapshot.pga = 0;
+      snapshot.timestamp = millis();
+      snapshot.status = D7S_BUS_NOT_SAMPLER;
+      return snapshot;
+   }
+   D7S_API_SCOPE(D7S_API_ACQUIRE_SAMPLE);
+   uint32_t start = micros();
+   D7SSnapshot snapshot = getSnapshot();
+   _sampleBusTime = micros() - start;
+   _samples.push(snapshot);
+
+   if (snapshot.status == D7S_BUS_OK) {
+      //without INT2 the start and the end of the earthquake come from STATE
+      if (!_int2Enabled) {
+         if (snapshot.state == NORMAL_MODE_NOT_IN_STANBY) {
+            if (!_eventStats.isActive()) {
+               _eventStats.begin(snapshot.timestamp);
+            }
+            if (_capture != NULL) {
+               _capture->trigger(snapshot.timestamp);
+            }
+         } else if (snapshot.state == NORMAL_MODE) {
+            _eventStats.end(snapshot.timestamp);
+            if (_capture != NULL) {
+               _capture->finish(snapshot.timestamp);
+            }
+         }
+      }
+      _eventStats.add(snapshot.timestamp, snapshot.si, snapshot.pga);
+      if (_capture != NULL) {
+         _capture->add(snapshot.timestamp, snapshot.si, snapshot.pga);
+      }
+   }
+
+   return snapshot;
+}
+
+//return a cursor positioned on the next sample that will be acquired
+D7SSampleCursor D7SClass::getSampleCursor() {
+   return _samples.cursor();
+}
+
+//copy the next sample of the cursor from the ring (no bus access), false if there is none
+bool D7SClass::readSample(D7SSampleCursor &cursor, D7SSnapshot &snapshot) {
+   return _samples.read(cursor, snapshot);
+}
+
+//attach a capture fed by acquireSample() and triggered by INT2 (NULL to detach)
+//with INT2 enabled the capture follows START_EARTHQUAKE/END_EARTHQUAKE, otherwise the STATE register of the samples
+void D7SClass::setCapture(D7SCapture *capture) {
+   _capture = capture;
+}
+
+//statistics of the current (or last) earthquake, updated by acquireSample()
+const D7SEventStats &D7SClass::getEventStats() {
+   return _eventStats.getStats();
+}
+
+//return the fastest sustainable sampling period while a capture is triggered [ms]
+//a sample may keep the bus busy at most half of the period, and the d7s does not refresh the data faster than D7S_CAPTURE_MIN_PERIOD
+uint16_t D7SClass::getCapturePeriod() {
+   uint32_t period = (2 * _sampleBusTime + 999) / 1000;
+   return period < D7S_CAPTURE_MIN_PERIOD ? D7S_CAPTURE_MIN_PERIOD : (uint16_t) period;
+}
+
+#if defined(ESP32)
+
+//start the acquisition task sampling at rate [Hz] (the task also runs processEvents(), so the handlers are called from it)
+bool D7SClass::startAcquisition(uint16_t rate, uint8_t core, uint8_t priority) {
+   //already running or invalid rate
+   if (_acquisitionTask != NULL || rate == 0) {
+      return false;
+   }
+   //sampling period (at least one tick)
+   _acquisitionPeriod = 1000 / rate;
+   if (_acquisitionPeriod == 0) {
+      _acquisitionPeriod = 1;
+   }
+   _acquisitionRunning = 1;
+   //create the task pinned to the requested core
+   if (xTaskCreatePinnedToCore(acquisitionTask, "d7s", D7S_ACQUISITION_STACK, this, priority, &_acquisitionTask, core) != pdPASS) {
+      _acquisitionRunning = 0;
+      _acquisitionTask = NULL;
+      return false;
+   }
+   return true;
+}
+
+//stop the acquisition task (it exits after the sample in progress)
+void D7SClass::stopAcquisition() {
+   if (_acquisitionTask == NULL) {
+      return;
+   }
+   _acquisitionRunning = 0;
+   //wake the task if it is waiting for the next sample
+   xTaskNotifyGive(_acquisitionTask);
+   //wait for the task to exit
+   while (_acquisitionTask != NULL) {
+      vTaskDelay(1);
+   }
+}
+
+//return true if the acquisition task is running
+uint8_t D7SClass::isAcquiring() {
+   return _acquisitionTask != NULL;
+}
+
+//body of the acquisition task
+void D7SClass::acquisitionTask(void *arg) {
+   D7SClass *d7s = (D7SClass *) arg;
+   TickType_t next = xTaskGetTickCount();
+   //from now on only this task samples and drains the interrupts
+   d7s->_acquisitionOwner = xTaskGetCurrentTaskHandle();
+
+   while (d7s->_acquisitionRunning) {
+      //sample
+      d7s->acquireSample();
+      //sample as fast as the bus allows while a capture is triggered
+      if (d7s->_capture != NULL && d7s->_capture->isTriggered()) {
+         next += pdMS_TO_TICKS(d7s->getCapturePeriod());
+      } else {
+         next += pdMS_TO_TICKS(d7s->_acquisitionPeriod);
+      }
+      //wait for the next sample, the isr wakes the task earlier when an interrupt is queued
+      do {
+         d7s->processEvents();
+         d7s->pollOperation();
+         TickType_t now = xTaskGetTickCount();
+         if ((int32_t) (next - now) <= 0) {
+            //late, do not try to catch up on the missed samples
+            next = now;
+            break;
+         }
+         ulTaskNotifyTake(pdTRUE, next - now);
+      } while (d7s->_acquisitionRunning && (int32_t) (next - xTaskGetTickCount()) > 0);
+   }
+
+   //notify stopAcquisition() and delete the task
+   d7s->_acquisitionOwner = NULL;
+   d7s->_acquisitionTask = NULL;
+   vTaskDelete(NULL);
+}
+
+#endif
+
+//read 8 bit from the specified register
+D7SResult<uint8_t> D7SClass::read8bit(uint8_t regH, uint8_t regL) {
+   D7SResult<uint8_t> result;
+   uint8_t data = 0;
+   //read 1 byte
+   result.status = readBlock(regH, regL, &data, 1);
+   result.value = data;
+   //return the data
+   return result;
+}
+
+//read 16 bit from the specified register
+D7SResult<uint16_t> D7SClass::read16bit(uint8_t regH, uint8_t regL) {
+   D7SResult<uint16_t> result;
+   uint8_t data[2] = {0, 0};
+   //read 2 byte (msb first)
+   result.status = readBlock(regH, regL, data, 2);
+   result.value = (data[0] << 8) | data[1];
+   //return the data
+   return result;
+}
+
+//read len consecutive bytes starting from the specified register (the d7s auto-increments the register address)
+d7s_bus_status D7SClass::readBlock(uint8_t regH, uint8_t regL, uint8_t *data, uint8_t len) {
+   //own the bus for all the attempts
+   D7SBusTransaction transaction(*_busLock, D7S_BUS_PRIORITY_NORMAL, _busLockTimeout);
+
+   //start timing the transaction (the deadline covers all the attempts)
+   uint32_t start = micros();
+   d7s_bus_status status;
+
+   if (!transaction.ok()) {
+      memset(data, 0, len);
+      endTransaction(D7S_BUS_LOCKED, start, regH, 0, 0);
+      D7S_TRACE_RECORD(D7S_TRACE_READ, _traceId, (regH << 8) | regL, 0, len, D7S_BUS_LOCKED, start, _lastLatency, 0, D7S_TRACE_API);
+      return D7S_BUS_LOCKED;
+   }
+
+   uint8_t attempt;
+
+   //try until success, out of retries or past the deadline
+   for (attempt = 0; ; attempt++) {
+      status = readBlockOnce(regH, regL, data, len);
+      if (status == D7S_BUS_OK || !waitRetry(attempt, start, status)) {
+         break;
+      }
+   }
+
+   //the data is zeroed on failure so callers never see a partial read
+   if (status != D7S_BUS_OK) {
+      memset(data, 0, len);
+   }
+
+   //every attempt puts on the wire: address+W, register address, address+R, data
+   endTransaction(status, start, regH, (4 + len) * (attempt + 1), attempt);
+   D7S_TRACE_RECORD(D7S_TRACE_READ, _traceId, (regH << 8) | regL, len > 1 ? (data[0] << 8) | data[1] : data[0], len, status, start, _lastLatency, attempt + 1, D7S_TRACE_API);
+   return status;
+}
+
+//single attempt of readBlock
+d7s_bus_status D7SClass::readBlockOnce(uint8_t regH, uint8_t regL, uint8_t *data, uint8_t len) {
+   //register address (high, low)
+   uint8_t address[2] = {regH, regL};
+
+   //write register address and send RE-START message
+   uint8_t status = _transport->write(D7S_ADDRESS, address, 2, false);
+
+   //if the status != 0 there is an error
+   if (status != 0) {
+      return toBusStatus(status);
+   }
+
+   //request len byte
+   uint8_t received = _transport->read(D7S_ADDRESS, data, len);
+
+   //the sensor did not send all the requested bytes
+   if (received < len) {
+      return D7S_BUS_SHORT_READ;
+   }
+
+   return D7S_BUS_OK;
+}
+
+//read the record block starting at regH:0x00
+d7s_bus_status D7SClass::readRecord(uint8_t regH, D7SRecord &record) {
+   uint8_t data[D7S_RECORD_SIZE];
+
+   //read the whole block in one sequential read
+   memset(data, 0, sizeof(data));
+   d7s_bus_status status = readBlock(regH, 0x00, data, D7S_RECORD_SIZE);
+
+   //unpack the registers (msb first)
+   record.offsetX = (int16_t) ((data[0] << 8) | data[1]);
+   record.offsetY = (int16_t) ((data[2] << 8) | data[3]);
+   record.offsetZ = (int16_t) ((data[4] << 8) | data[5]);
+   record.temperature = (int16_t) ((data[6] << 8) | data[7]);
+   record.si = (data[8] << 8) | data[9];
+   record.pga = (data[10] << 8) | data[11];
+
+   return status;
+}
+
+//return true if two records hold the same values
+bool D7SClass::sameRecord(const D7SRecord &a, const D7SRecord &b) {
+   return a.offsetX == b.offsetX && a.offsetY == b.offsetY && a.offsetZ == b.offsetZ && a.temperature == b.temperature && a.si == b.si && a.pga == b.pga;
+}
+
+//write 8 bit to the register specified
+d7s_bus_status D7SClass::write8bit(uint8_t regH, uint8_t regL, uint8_t val) {
+   //own the bus for all the attempts
+   D7SBusTransaction transaction(*_busLock, D7S_BUS_PRIORITY_NORMAL, _busLockTimeout);
+
+   //start timing the transaction (the deadline covers all the attempts)
+   uint32_t start = micros();
+   d7s_bus_status status;
+
+   if (!transaction.ok()) {
+      endTransaction(D7S_BUS_LOCKED, start, regH, 0, 0);
+      D7S_TRACE_RECORD(D7S_TRACE_WRITE, _traceId, (regH << 8) | regL, val, 1, D7S_BUS_LOCKED, start, _lastLatency, 0, D7S_TRACE_API);
+      return D7S_BUS_LOCKED;
+   }
+
+   uint8_t attempt;
+
+   //try until success, out of retries or past the deadline
+   for (attempt = 0; ; attempt++) {
+      status = write8bitOnce(regH, regL, val);
+      if (status == D7S_BUS_OK || !waitRetry(attempt, start, status)) {
+         break;
+      }
+   }
+
+   //every attempt puts on the wire: address+W, register address, data
+   endTransaction(status, start, regH, 4 * (attempt + 1), attempt);
+   D7S_TRACE_RECORD(D7S_TRACE_WRITE, _traceId, (regH << 8) | regL, val, 1, status, start, _lastLatency, attempt + 1, D7S_TRACE_API);
+   return status;
+}
+
+//single attempt of write8bit
+d7s_bus_status D7SClass::write8bitOnce(uint8_t regH, uint8_t regL, uint8_t val) {
+   //register address (high, low) and data
+   uint8_t message[3] = {regH, regL, val};
+
+   //write register address and data, closing the connection (STOP message)
+   uint8_t status = _transport->write(D7S_ADDRESS, message, 3, true);
+
+   return toBusStatus(status);
+}
+
+//wait the backoff before the next attempt, return false if there are no attempts left (status is updated on timeout)
+bool D7SClass::waitRetry(uint8_t attempt, uint32_t start, d7s_bus_status &status) {
+   //no more retries allowed
+   if (attempt >= _busRetries) {
+      return false;
+   }
+   //exponential backoff (backoff, 2*backoff, 4*backoff, ...), a 16 bit backoff shifted up to 16 times fits 32 bits
+   uint32_t backoff = attempt <= 16 ? ((uint32_t) _busBackoff) << attempt : UINT32_MAX;
+   //the next attempt would start past the deadline (compared without overflowing)
+   uint32_t deadline = ((uint32_t) _busTimeout) * 1000;
+   if (backoff >= deadline || micros() - start >= deadline - backoff) {
+      status = D7S_BUS_TIMEOUT;
+      return false;
+   }
+   //count the retry and wait
+   _busRetryCount++;
+   delayMicroseconds(backoff);
+   return true;
+}
+
+//update the bus counters at the end of a register access
+void D7SClass::endTransaction(d7s_bus_status status, uint32_t start, uint8_t regH, uint16_t bytes, uint8_t retries) {
+   //save the latency of the register access (retries included)
+   _lastLatency = micros() - start;
+   //save the status
+   _lastStatus = status;
+   if (status != D7S_BUS_OK) {
+      _busFailureCount++;
+   }
+
+   #ifndef D7S_DISABLE_STATS
+      //the statistics are touched only by the owner of the bus lock, an access that could not take it is counted by the lock (getTimeouts())
+      if (status == D7S_BUS_LOCKED) {
+         return;
+      }
+      //charge the access to the whole bus, to the register block and to the public method that caused it
+      D7SBusCounters *counters[3] = {&_stats.total, &_stats.block[toRegisterBlock(regH)], &_stats.api[currentApi()]};
+      for (uint8_t i = 0; i < 3; i++) {
+         counters[i]->transactions++;
+         counters[i]->bytes += bytes;
+         counters[i]->retries += retries;
+         counters[i]->failures += status != D7S_BUS_OK;
+         counters[i]->busTime += _lastLatency;
+      }
+   #else
+      (void) regH;
+      (void) bytes;
+      (void) retries;
+   #endif
+}
+
+#ifndef D7S_DISABLE_STATS
+
+//register block of a high address
+d7s_register_block D7SClass::toRegisterBlock(uint8_t regH) {
+   if (regH == 0x10) {
+      return D7S_BLOCK_STATUS;
+   }
+   if (regH == 0x20) {
+      return D7S_BLOCK_INSTANTANEOUS;
+   }
+   if (regH >= 0x30 && regH <= 0x34) {
+      return D7S_BLOCK_LATEST;
+   }
+   if (regH >= 0x35 && regH <= 0x39) {
+      return D7S_BLOCK_RANKED;
+   }
+   return D7S_BLOCK_OTHER;
+}
+
+//open the scope of a public method (nested calls are charged to the outermost one)
+D7SApiScope::D7SApiScope(D7SClass *d7s, d7s_api api) {
+   _d7s = d7s;
+   _api = api;
+   _previous = _current;
+   //a method called by another method of the same instance is charged to the outer one
+   _owner = current(d7s) == D7S_API_NONE;
+   if (_owner) {
+      _current = this;
+      D7SBusTransaction transaction(*d7s->_busLock, D7S_BUS_PRIORITY_NORMAL, d7s->_busLockTimeout);
+      if (transaction.ok()) {
+         d7s->_stats.api[api].calls++;
+      }
+   }
+}
+
+//close the scope of a public method
+D7SApiScope::~D7SApiScope() {
+   if (_owner) {
+      _current = _previous;
+   }
+}
+
+//method of the innermost scope of the calling task on d7s (D7S_API_NONE if none)
+d7s_api D7SApiScope::current(D7SClass *d7s) {
+   for (D7SApiScope *scope = _current; scope != NULL; scope = scope->_previous) {
+      if (scope->_d7s == d7s) {
+         return scope->_api;
+      }
+   }
+   return D7S_API_NONE;
+}
+
+#endif
+
+//convert the Wire.endTransmission() code to a bus status
+d7s_bus_status D7SClass::toBusStatus(uint8_t wireStatus) {
+   switch (wireStatus) {
+      case 0: return D7S_BUS_OK;
+      case 2: return D7S_BUS_NACK_ADDRESS;
+      case 3: return D7S_BUS_NACK_DATA;
+      case 5: return D7S_BUS_TIMEOUT;
+      default: return D7S_BUS_ERROR;
+   }
+}
+
+//read the event (SHUTOFF/COLLAPSE) from the EVENT register
+void D7SClass::readEvents() {
+   //read the EVENT register at 0x1002 (from the cache if fresh), readStatusRegister() updates the _events variable
+   readStatusRegister(D7S_REG_EVENT);
+}
+
+//read STATE, AXIS_STATE or EVENT, from the cache if the last read is within the freshness window
+D7SResult<uint8_t> D7SClass::readStatusRegister(uint8_t regL) {
+   D7SCachedRegister &cache = _statusCache[regL];
+   D7SResult<uint8_t> result;
+
+   //fresh enough, no bus access
+   if (cache.valid && millis() - cache.timestamp < _cacheWindow) {
+      result.status = D7S_BUS_OK;
+      result.value = cache.value;
+      return result;
+   }
+
+   //read the register and refresh the cache
+   result = read8bit(0x10, regL);
+   if (result.ok()) {
+      cache.value = result.value;
+      cache.timestamp = millis();
+      cache.valid = 1;
+      //reading EVENT clears it, keep the SHUTOFF/COLLAPSE bits every time it is read
+      if (regL == D7S_REG_EVENT) {
+         _events |= result.value & 0x03;
+      }
+   } else {
+      cache.valid = 0;
+   }
+   return result;
+}
+
+//return CTRL from the shadow copy, read it from the d7s the first time
+D7SResult<uint8_t> D7SClass::readCtrl() {
+   D7SResult<uint8_t> result;
+
+   //the shadow copy is up to date (CTRL only changes when we write it)
+   if (_ctrlValid) {
+      result.status = D7S_BUS_OK;
+      result.value = _ctrlShadow;
+      return result;
+   }
+
+   //read the CTRL register at 0x1004
+   result = read8bit(0x10, 0x04);
+   if (result.ok()) {
+      _ctrlShadow = result.value;
+      _ctrlValid = 1;
+   }
+   return result;
+}
+
+//write CTRL and update the shadow copy (write-through)
+d7s_bus_status D7SClass::writeCtrl(uint8_t val) {
+   d7s_bus_status status = write8bit(0x10, 0x04, val);
+   //on failure we do not know what the d7s holds, read it again next time
+   _ctrlShadow = val;
+   _ctrlValid = status == D7S_BUS_OK;
+   return status;
+}
+
+//record an interrupt in the queue (interrupt context: no bus access, no handlers)
+D7S_ISR_ATTR void D7SClass::pushInterrupt(uint8_t source, uint8_t level) {
+   //queue full, the event is lost
+   if ((uint8_t) (_interruptHead - _interruptTail) >= D7S_INTERRUPT_QUEUE_SIZE) {
+      _droppedInterrupts++;
+      return;
+   }
+   //fill the slot before publishing it to processEvents()
+   D7SInterrupt &interrupt = _interruptQueue[_interruptHead & (D7S_INTERRUPT_QUEUE_SIZE - 1)];
+   interrupt.source = source;
+   interrupt.level = level;
+   interrupt.timestamp = millis();
+   __sync_synchronize();
+   _interruptHead++;
+   D7S_TRACE_RECORD(source == 1 ? D7S_TRACE_INT1 : D7S_TRACE_INT2, _traceId, 0, level, 0, D7S_BUS_OK, micros(), 0, 0, D7S_API_NONE);
+
+   //an interrupt means STATE/EVENT changed, the next read must go to the d7s
+   invalidateCache(D7S_REG_STATE);
+   invalidateCache(D7S_REG_EVENT);
+
+   //wake the acquisition task so the event is processed right away
+   #if defined(ESP32)
+      if (_acquisitionTask != NULL) {
+         BaseType_t woken = pdFALSE;
+         vTaskNotifyGiveFromISR(_acquisitionTask, &woken);
+         if (woken) {
+            portYIELD_FROM_ISR();
+         }
+      }
+   #endif
+}
+
+//handle the INT1 events, true if payload has to be dispatched
+bool D7SClass::int1(const D7SInterrupt &interrupt, D7SEvent &payload) {
+   //INT1 changes no state, the EVENT register is read only for the handlers
+   if (!_interruptEnabled) {
+      return false;
+   }
+   //check what event triggered the interrupt
+   d7s_interrupt_event event = isInShutoff() ? SHUTOFF_EVENT : COLLAPSE_EVENT;
+   return prepareEvent(payload, event, interrupt.timestamp);
+}
+
+//handle the INT2 events, true if payload has to be dispatched
+bool D7SClass::int2(const D7SInterrupt &interrupt, D7SEvent &payload) {
+   //INT2 goes LOW while the d7s is processing an earthquake and HIGH when it ends
+   //INT2 is LOW also during initial installation, offset acquisition and selftest, those are not earthquakes
+   if (_modeInProgress) {
+      //the mode is over when INT2 goes back HIGH
+      if (interrupt.level == HIGH) {
+         _modeInProgress = 0;
+      }
+      return false;
+   }
+   if (interrupt.level == LOW) { //earthquake started
+      _earthquakeActive = 1;
+      _eventStats.begin(interrupt.timestamp);
+      if (_capture != NULL) {
+         _capture->trigger(interrupt.timestamp);
+      }
+      return prepareEvent(payload, START_EARTHQUAKE, interrupt.timestamp);
+   } else if (_earthquakeActive) { //earthquake ended
+      _earthquakeActive = 0;
+      if (_capture != NULL) {
+         _capture->finish(interrupt.timestamp);
+      }
+      _eventStats.end(interrupt.timestamp);
+      //add the record of the earthquake that just ended, read in one transaction
+      memset(&_eventRecord, 0, sizeof(_eventRecord));
+      bool recordValid = readRecord(0x30, _eventRecord) == D7S_BUS_OK;
+      if (recordValid) {
+         _eventStats.setRecord(_eventRecord.si, _eventRecord.pga, _eventRecord.temperature);
+      }
+      if (prepareEvent(payload, END_EARTHQUAKE, interrupt.timestamp)) {
+         payload.record = recordValid ? &_eventRecord : NULL;
+         payload.stats = &_eventStats.getStats();
+         return true;
+      }
+   }
+   return false;
+}
+
+//fill the common part of the payload, false if the interrupt handling is disabled or the event has no subscribers (then the bus is not touched)
+bool D7SClass::prepareEvent(D7SEvent &payload, d7s_interrupt_event event, uint32_t timestamp) {
+   if (!_interruptEnabled || _subscriberCount[event] == 0) {
+      return false;
+   }
+   payload.event = event;
+   payload.timestamp = timestamp;
+   //one read shared by all the subscribers
+   payload.snapshot = getSnapshot();
+   payload.record = NULL;
+   payload.stats = NULL;
+   payload.sensor = this;
+   return true;
+}
+
+//call the subscribers of the event in registration order (at most D7S_MAX_SUBSCRIBERS calls)
+void D7SClass::dispatch(const D7SEvent &payload) {
+   const D7SSubscriber *subscribers = _subscribers[payload.event];
+   uint8_t count = _subscriberCount[payload.event];
+   for (uint8_t i = 0; i < count; i++) {
+      subscribers[i].callback(payload, subscribers[i].ctx);
+   }
+}
+
+//adapter of the handlers without arguments, ctx is their slot in _handlers
+void D7SClass::callHandler(const D7SEvent &event, void *ctx) {
+   (void) event;
+   void (*handler) () = *(void (**) ()) ctx;
+   if (handler) {
+      handler();
+   }
+}
+
+//adapter of the END_EARTHQUAKE handler with the record (SI [m/s], PGA [m/s^2], temperature [C], 0 if the read failed)
+void D7SClass::callRecordHandler(const D7SEvent &event, void *ctx) {
+   void (*handler) (float, float, float) = *(void (**) (float, float, float)) ctx;
+   if (handler) {
+      D7SRecord record = {};
+      if (event.record != NULL) {
+         record = *event.record;
+      }
+      handler(((float) record.si) / 1000, ((float) record.pga) / 1000, ((float) record.temperature) / 10);
+   }
+}
+
+//adapter of the END_EARTHQUAKE handler with the statistics
+void D7SClass::callStatsHandler(const D7SEvent &event, void *ctx) {
+   void (*handler) (const D7SEventStats &) = *(void (**) (const D7SEventStats &)) ctx;
+   if (handler && event.stats != NULL) {
+      handler(*event.stats);
+   }
+}
+
+//attach the isr of this instance for INT1 (source 1) or INT2 (source 2) to pin
+bool D7SClass::attachIsr(uint8_t pin, uint8_t source, int mode) {
+   #if defined(D7S_INTERRUPT_ARG)
+      //the isr gets the instance as argument
+      attachInterruptArg(digitalPinToInterrupt(pin), source == 1 ? isr1 : isr2, this, mode);
+   #else
+      //take a free slot the first time, INT1 and INT2 share it
+      if (_interruptSlot < 0) {
+         noInterrupts();
+         for (uint8_t slot = 0; slot < D7S_MAX_INSTANCES && _interruptSlot < 0; slot++) {
+            if (_interruptSlots[slot] == NULL) {
+               _interruptSlots[slot] = this;
+               _interruptSlot = slot;
+            }
+         }
+         interrupts();
+         if (_interruptSlot < 0) {
+            return false;
+         }
+      }
+      attachInterrupt(digitalPinToInterrupt(pin), source == 1 ? _isr1Slots[_interruptSlot] : _isr2Slots[_interruptSlot], mode);
+   #endif
+   return true;
+}
+
+//read the INT2 level and queue the edge (interrupt context)
+D7S_ISR_ATTR void D7SClass::handleINT2() {
+   uint8_t level = digitalRead(_pinINT2);
+   // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
+   // as RISING the same pin detaching the previus interrupt
+   #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
+      // Detaching the previus interrupt
+      detachInterrupt(digitalPinToInterrupt(_pinINT2));
+      // Attaching the same interrupt on the opposite edge
+      attachInterrupt(digitalPinToInterrupt(_pinINT2), _isr2Slots[_interruptSlot], level == LOW ? RISING : FALLING);
+   #endif
+   pushInterrupt(2, level);
+}
+
+#if defined(D7S_INTERRUPT_ARG)
+
+//it handle the FALLING event that occur to the INT1 D7S pin (glue routine)
+D7S_ISR_ATTR void D7SClass::isr1(void *arg) {
+   ((D7SClass *) arg)->pushInterrupt(1, LOW);
+}
+
+//it handle the CHANGE event thant occur to the INT2 D7S pin (glue routine)
+D7S_ISR_ATTR void D7SClass::isr2(void *arg) {
+   ((D7SClass *) arg)->handleINT2();
+}
+
+#else
+
+//isr1 of the instance in the slot (glue routine)
+template <uint8_t slot>
+D7S_ISR_ATTR void D7SClass::isr1Slot() {
+   _interruptSlots[slot]->pushInterrupt(1, LOW);
+}
+
+//isr2 of the instance in the slot (glue routine)
+template <uint8_t slot>
+D7S_ISR_ATTR void D7SClass::isr2Slot() {
+   _interruptSlots[slot]->handleINT2();
+}
+
+//isrs of the slots (one per D7S_MAX_INSTANCES), a different D7S_MAX_INSTANCES needs these tables updated
+static_assert(D7S_MAX_INSTANCES == 4, "the isr slot tables list 4 entries, update them with D7S_MAX_INSTANCES");
+void (*const D7SClass::_isr1Slots[D7S_MAX_INSTANCES])() = {isr1Slot<0>, isr1Slot<1>, isr1Slot<2>, isr1Slot<3>};
+void (*const D7SClass::_isr2Slots[D7S_MAX_INSTANCES])() = {isr2Slot<0>, isr2Slot<1>, isr2Slot<2>, isr2Slot<3>};
+
+#endif
 
+//extern object
+#if defined(ARDUINO)
+D7SClass D7S;
 #endif
@@ -1,472 +1,688 @@
-#include "D7S.h"
-
-//CONSTRUCTOR/DESTROYER
-D7SClass::D7SClass() {
-   //reset handler array
-   for (int i = 0; i < 4; i++) {
-      _handlers[i] = NULL;
-   }
-
-   _events = 0;
-
-}
-
-//used to initialize Wire
-void D7SClass::begin() {
-   //begin Wire
-   WireD7S.begin();
-}
-
-//return the currect state
-d7s_status D7SClass::getState() {
-   //read the STATE register at 0x1000
-   return (d7s_status) (read8bit(0x10, 0x00) & 0x07);
-}
-
-//return the currect state
-d7s_axis_state D7SClass::getAxisInUse() {
-   //read the AXIS_STATE register at 0x1001
-   return (d7s_axis_state) (read8bit(0x10, 0x01) & 0x03);
-}
-
-//settings
-//change the threshold in use (0=highly sensitive, 1=normal)
-void D7SClass::setThreshold(d7s_threshold threshold) {
-   //check if threshold is valid
-   if (threshold < 0 || threshold > 1) {
-      return;
-   }
-   //read the CTRL register at 0x1004
-   uint8_t reg = read8bit(0x10, 0x04);
-   //new register value with the threshold
-   reg = (((reg >> 4) << 1) | (threshold & 0x01)) << 3;
-   write8bit(0x10, 0x04, reg);
-}
-
-//change the axis selection mode
-void D7SClass::setAxis(d7s_axis_settings axisMode) {
-   //check if axisMode is valid
-   if (axisMode < 0 or axisMode > 4) {
-      return;
-   }
-   //read the CTRL register at 0x1004
-   uint8_t reg = read8bit(0x10, 0x04);
-   //new register value with the threshold
-   reg = (axisMode << 4) | (reg & 0x0F);
-   //update register
-   write8bit(0x10, 0x04, reg);
-}
-
-//get the lastest pgv at specified index (up to 5) [m/s]
-float D7SClass::getLastestPGV(uint8_t index) {
-   //check if the index is in bound
-   if (index < 0 || index > 4) {
-      return 0;
-   }
-   //return the value
-   return ((float) read16bit(0x30 + index, 0x08)) / 1000;
-}
-
-//get the lastest PGA at specified index (up to 5) [m/s^2]
-float D7SClass::getLastestPGA(uint8_t index) {
-   //check if the index is in bound
-   if (index < 0 || index > 4) {
-      return 0;
-   }
-   //return the value
-   return ((float) read16bit(0x30 + index, 0x0A)) / 1000;
-}
-
-//get instantaneus PGV (during an earthquake) [m/s]
-float D7SClass::getInstantaneusPGV() {
-   //return the value
-   return ((float) read16bit(0x20, 0x00)) / 1000;
-}
-
-//get instantaneus PGA (during an earthquake) [m/s^2]
-float D7SClass::getInstantaneusPGA() {
-   //return the value
-   return ((float) read16bit(0x20, 0x02)) / 1000;
-}
-
-//get intensity
-uint8_t D7SClass::getIntensity() {
-    float pga = getInstantaneusPGA();  // Example: get PGA value for intensity calculation
-
-    //define thresholds for the PHIVOLCS intensity scale
-    if (pga == 0) {return 0;}                           //Intensity 0
-    if (pga > 0 && pga < 0.01) {return 1;}              //Intensity I
-    else if (pga >= 0.01 && pga < 0.02) {return 2;}     //Intensity II
-    else if (pga >= 0.02 && pga < 0.05) {return 3;}     //Intensity III
-    else if (pga >= 0.05 && pga < 0.10) {return 4;}     //Intensity IV
-    else if (pga >= 0.10 && pga < 0.25) {return 5;}     //Intensity V
-    else if (pga >= 0.25 && pga < 0.50) {return 6;}     //Intensity VI
-    else if (pga >= 0.50 && pga < 1.00) {return 7;}     //Intensity VII
-    else if (pga >= 1.00 && pga < 2.50) {return 8;}     //Intensity VIII
-    else if (pga >= 2.50 && pga < 5.00) {return 9;}     //Intensity IX
-    else{
-        return 10;}                     // Intensity X
-}
-
-//delete both the lastest data and the ranked data
-void D7SClass::clearEarthquakeData() {
-   //write clear command
-   write8bit(0x10, 0x05, 0x01);
-}
-
-//delete initializzazion data
-void D7SClass::clearInstallationData() {
-   //write clear command
-   write8bit(0x10, 0x05, 0x08);
-}
-
-//delete offset data
-void D7SClass::clearLastestOffsetData() {
-   //write clear command
-   write8bit(0x10, 0x05, 0x04);
-}
-
-//delete selftest data
-void D7SClass::clearSelftestData() {
-   //write clear command
-   write8bit(0x10, 0x05, 0x02);
-}
-
-//delete all data
-void D7SClass::clearAllData() {
-   //write clear command
-   write8bit(0x10, 0x05, 0x0F);
-}
-
-//initialize the d7s (start the initial installation mode)
-void D7SClass::initialize() {
-   //write INITIAL INSTALLATION MODE command
-   write8bit(0x10, 0x03, 0x02);
-}
-
-//start autodiagnostic and resturn the result (OK/ERROR)
-void D7SClass::selftest() {
-   //write SELFTEST command
-   write8bit(0x10, 0x03, 0x04);
-}
-
-//return the result of self-diagnostic test (OK/ERROR)
-d7s_mode_status D7SClass::getSelftestResult() {
-   //return result of the selftest
-   return (d7s_mode_status) ((read8bit(0x10, 0x02) & 0x07) >> 2);
-}
-
-//start offset acquisition and return the rersult (OK/ERROR)
-void D7SClass::acquireOffset() {
-   //write OFFSET ACQUISITION MODE command
-   write8bit(0x10, 0x03, 0x03);
-}
-
-//return the result of offset acquisition test (OK/ERROR)
-d7s_mode_status D7SClass::getAcquireOffsetResult() {
-   //return result of the offset acquisition
-   return (d7s_mode_status) ((read8bit(0x10, 0x02) & 0x0F) >> 3);
-}
-
-//after each earthquakes it's important to reset the events calling resetEvents() to prevent polluting the new data with the old one
-//return true if the collapse condition is met (it's the sencond bit of _events)
-uint8_t D7SClass::isInCollapse() {
-   //updating the _events variable
-   readEvents();
-   //return the second bit of _events
-   return (_events & 0x02) >> 1;
-}
-
-//return true if the shutoff condition is met (it's the first bit of _events)
-uint8_t D7SClass::isInShutoff() {
-   //updating the _events variable
-   readEvents();
-   //return the second bit of _events
-   return _events & 0x01;
-}
-
-//reset shutoff/collapse events
-void D7SClass::resetEvents() {
-   //reset the EVENT register (read to zero-ing it)
-   read8bit(0x10, 0x02);
-   //reset the events variable
-   _events = 0;
-}
-
-//return true if an earthquake is occuring
-uint8_t D7SClass::isEarthquakeOccuring() {
-   //if D7S is in NORMAL MODE NOT IN STANBY (after the first 4 sec to initial delay) there is an earthquake
-   return getState() == NORMAL_MODE_NOT_IN_STANBY;
-}
-
-uint8_t D7SClass::isReady() {
-   return getState() == NORMAL_MODE;
-}
-
-
-//enable interrupt INT1 on specified pin
-void D7SClass::enableInterruptINT1(uint8_t pin) {
-   //enable pull up resistor
-   pinMode(pin, INPUT_PULLUP);
-   //attach interrupt
-   attachInterrupt(digitalPinToInterrupt(pin), isr1, FALLING);
-}
-
-//enable interrupt INT2 on specified pin
-void D7SClass::enableInterruptINT2(uint8_t pin) {
-   //enable pull up resistor
-   pinMode(pin, INPUT_PULLUP);
-   // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
-   // as RISING the same pin detaching the previus interrupt
-   #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
-      pinINT2 = pin;
-      //attach interrupt
-      attachInterrupt(digitalPinToInterrupt(pin), isr2, FALLING);
-   #else
-      //attach interrupt
-      attachInterrupt(digitalPinToInterrupt(pin), isr2, CHANGE);
-   #endif
-}
-
-//start interrupt handling
-void D7SClass::startInterruptHandling() {
-   //enabling interrupt handling
-   _interruptEnabled = 1;
-}
-
-//stop interrupt handling
-void D7SClass::stopInterruptHandling() {
-   //disabling interrupt handling
-   _interruptEnabled = 0;
-}
-
-//assing the handler to the specific event
-void D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) ()) {
-   //check if event is in bound (it's the index to the handlers array)
-   if (event < 0 || event > 3) {
-      return;
-   }
-   //copy the pointer to the array
-   _handlers[event] = handler;
-}
-
-void D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) (float, float, float)) {
-  registerInterruptEventHandler(event, (void (*)()) handler);
-}
-
-//read 8 bit from the specified register
-uint8_t D7SClass::read8bit(uint8_t regH, uint8_t regL) {
-
-   //DEBUG
-   #ifdef DEBUG
-      Serial.println("--- read8bit ---");
-      Serial.print("REG: 0x");
-      Serial.print(regH, HEX);
-      Serial.println(regL, HEX);
-   #endif
-
-   //setting up i2c connection
-   WireD7S.beginTransmission(D7S_ADDRESS);
-   
-   //write register address
-   WireD7S.write(regH); //register address high
-   delay(10); //delay to prevent freezing
-   WireD7S.write(regL); //register address low
-   delay(10); //delay to prevent freezing
-   
-   //send RE-START message
-   uint8_t status = WireD7S.endTransmission(false);
-
-   //DEBUG
-   #ifdef DEBUG
-      Serial.print("[RE-START]: ");
-      //send RE-START message
-      Serial.println(status);
-   #endif
-
-   //if the status != 0 there is an error
-   if (status != 0) {
-      //retry
-      return read8bit(regH, regL);
-   }
-
-   //request 1 byte
-   WireD7S.requestFrom(D7S_ADDRESS, 1);
-   //wait until the data is received
-   while (WireD7S.available() < 1)
-      ;
-   //read the data
-   uint8_t data = WireD7S.read();
-
-   //DEBUG
-   #ifdef DEBUG
-      Serial.println("--- read8bit ---");
-   #endif
-  
-   //return the data
-   return data;
-}
-
-//read 16 bit from the specified register
-uint16_t D7SClass::read16bit(uint8_t regH, uint8_t regL) {
-
-   //DEBUG
-   #ifdef DEBUG
-      Serial.println("--- read16bit ---");
-      Serial.print("REG: 0x");
-      Serial.print(regH, HEX);
-      Serial.println(regL, HEX);
-   #endif
-
-   //setting up i2c connection
-   WireD7S.beginTransmission(D7S_ADDRESS);
-   
-   //write register address
-   WireD7S.write(regH); //register address high
-   delay(10); //delay to prevent freezing
-   WireD7S.write(regL); //register address low
-   delay(10); //delay to prevent freezing
-   
-   //send RE-START message
-   uint8_t status = WireD7S.endTransmission(false);
-
-   //DEBUG
-   #ifdef DEBUG
-      Serial.print("[RE-START]: ");
-      //send RE-START message
-      Serial.println(status);
-   #endif
-
-   //if the status != 0 there is an error
-   if (status != 0) {
-      //retry again
-      return read16bit(regH, regL);
-   }
-
-   //request 2 byte
-   WireD7S.requestFrom(D7S_ADDRESS, 2);
-   //wait until the data is received
-   while (WireD7S.available() < 2)
-      ;
-   //read the data
-   uint8_t msb = WireD7S.read();
-   uint8_t lsb = WireD7S.read();
-
-   //DEBUG
-   #ifdef DEBUG
-      Serial.println("--- read16bit ---");
-   #endif
-
-   //return the data
-   return (msb << 8) | lsb;
-}
-
-//write 8 bit to the register specified
-void D7SClass::write8bit(uint8_t regH, uint8_t regL, uint8_t val) {
-   //DEBUG
-   #ifdef DEBUG
-      Serial.println("--- write8bit ---");
-   #endif
-
-   //setting up i2c connection
-   WireD7S.beginTransmission(D7S_ADDRESS);
-   
-   //write register address
-   WireD7S.write(regH); //register address high
-   delay(10); //delay to prevent freezing
-   WireD7S.write(regL); //register address low
-   delay(10); //delay to prevent freezing
-   
-   //write data
-   WireD7S.write(val);
-   delay(10); //delay to prevent freezing
-   //closing the connection (STOP message)
-   uint8_t status = WireD7S.endTransmission(true);
-
-   //DEBUG
-   #ifdef DEBUG
-      Serial.print("[STOP]: ");
-      //closing the connection (STOP message)
-      Serial.println(status);
-      Serial.println("--- write8bit ---");
-   #endif
-}
-
-//read the event (SHUTOFF/COLLAPSE) from the EVENT register
-void D7SClass::readEvents() {
-   //read the EVENT register at 0x1002 and obtaining only the first two bits
-   uint8_t events = read8bit(0x10, 0x02) & 0x03;
-   //updating the _events variable
-   _events |= events;
-}
-
-//handle the INT1 events
-void D7SClass::int1() {
-   //enabling interrupts
-   interrupts();
-   //if the interrupt handling is enabled
-   if (_interruptEnabled) {
-      //check what event triggered the interrupt
-      if (isInShutoff()) {
-         //if the handler is defined
-         if (_handlers[2]) {
-            _handlers[2](); //SHUTOFF_EVENT EVENT
-         }
-      } else {
-         //if the handler is defined
-         if (_handlers[3]) {
-            _handlers[3](); //COLLAPSE_EVENT EVENT
-         }
-      }
-   }
-}
-
-//handle the INT2 events
-void D7SClass::int2() {
-   //enabling interrupts
-   interrupts();
-   //if the interrupt handling is enabled
-   if (_interruptEnabled) {
-      //check what in what state the D7S is
-      if (isEarthquakeOccuring()) { //earthquake started
-         // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
-         // as RISING the same pin detaching the previus interrupt
-         #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
-            // Detaching the previus interrupt as FALLING
-            detachInterrupt(digitalPinToInterrupt(pinINT2));
-            // Attaching the same interrupt as RISING
-            attachInterrupt(digitalPinToInterrupt(pinINT2), isr2, RISING);
-         #endif
-         //if the handler is defined
-         if (_handlers[0]) {
-            _handlers[0](); //START_EARTHQUAKE EVENT
-         }
-      } else { //earthquake ended
-         // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
-         // as RISING the same pin detaching the previus interrupt
-         #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
-            // Detaching the previus interrupt as FALLING
-            detachInterrupt(digitalPinToInterrupt(pinINT2));
-            // Attaching the same interrupt as RISING
-            attachInterrupt(digitalPinToInterrupt(pinINT2), isr2, FALLING);
-         #endif
-         //if the handler is defined
-         if (_handlers[1]) {
-            ((void (*)(float, float, float)) _handlers[1])(getLastestSI(0), getLastestPGA(0), getLastestTemperature(0)); //END_EARTHQUAKE EVENT
-         }
-      }
-   }
-}
-
-//it handle the FALLING event that occur to the INT1 D7S pin (glue routine)
-void D7SClass::isr1() {
-   D7S.int1();
-}
-
-//it handle the CHANGE event thant occur to the INT2 D7S pin (glue routine)
-void D7SClass::isr2() {
-   D7S.int2();
-}
-
-//extern object
-D7SClass D7S;
+#ifndef D7S_H
+#define D7S_H
+
+#include "D7SPlatform.h"
+#include "D7STransport.h"
+#include "D7SSampleRing.h"
+#include "D7SIntensity.h"
+#include "D7SCapture.h"
+#include "D7SEventStats.h"
+#include "D7STrace.h"
+
+#if defined(ESP32)
+   #include <freertos/FreeRTOS.h>
+   #include <freertos/task.h>
+#endif
+
+// If the board is Fishino32 then we need to fix I2C interrupts priority
+#if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
+   // Include fix file
+   #include "../utils/Fishino32.h"
+   // Define the new Wire instance to use
+   #define WireD7S _Wire
+#elif defined(ARDUINO)
+   #define WireD7S Wire
+#endif
+
+//--- ADDRESS ---
+#define D7S_ADDRESS 0x55 //D7S address on the I2C bus
+
+//--- BUS CLOCK ---
+#define D7S_I2C_STANDARD_MODE 100000 //100 kHz
+#define D7S_I2C_FAST_MODE 400000 //400 kHz
+
+//--- RETRY POLICY ---
+#define D7S_DEFAULT_RETRIES 3 //retries after the first attempt
+#define D7S_DEFAULT_BACKOFF 500 //backoff before the first retry, doubled at every retry [us]
+#define D7S_DEFAULT_TIMEOUT 50 //deadline of a register access, retries included [ms]
+
+//--- REGISTER CACHE ---
+#define D7S_DEFAULT_CACHE_WINDOW 0 //how long STATE/AXIS_STATE/EVENT are served from the cache [ms] (0 = always read)
+
+//low address of the cached status registers (high address is 0x10)
+#define D7S_REG_STATE 0x00
+#define D7S_REG_AXIS_STATE 0x01
+#define D7S_REG_EVENT 0x02
+
+//--- INTERRUPT QUEUE ---
+#define D7S_INTERRUPT_QUEUE_SIZE 8 //interrupts buffered between two processEvents() calls (power of two)
+static_assert(D7S_INTERRUPT_QUEUE_SIZE > 0 && (D7S_INTERRUPT_QUEUE_SIZE & (D7S_INTERRUPT_QUEUE_SIZE - 1)) == 0, "D7S_INTERRUPT_QUEUE_SIZE must be a power of two (the index is masked)");
+
+//functions called from interrupt context must be in IRAM on ESP32
+#if defined(ESP32)
+   #define D7S_ISR_ATTR IRAM_ATTR
+#else
+   #define D7S_ISR_ATTR
+#endif
+
+//--- INTERRUPT ROUTING ---
+//ESP32 (and the host build) pass the instance to the isr with attachInterruptArg(),
+//other boards route the interrupts through a table of D7S_MAX_INSTANCES slots
+#if defined(ESP32) || !defined(ARDUINO)
+   #define D7S_INTERRUPT_ARG
+#endif
+#define D7S_MAX_INSTANCES 4 //instances with interrupts enabled at the same time (boards without attachInterruptArg)
+#define D7S_MAX_WIRES 2 //TwoWire buses used by the Wire constructors (one transport each, shared by the instances on the bus)
+
+//--- ACQUISITION TASK (ESP32) ---
+#define D7S_ACQUISITION_CORE 1 //core of the acquisition task (the ESP32 network stack runs on core 0)
+#define D7S_ACQUISITION_PRIORITY 2 //FreeRTOS priority of the acquisition task
+#define D7S_ACQUISITION_STACK 4096 //stack of the acquisition task [byte]
+
+//--- ASYNCHRONOUS OPERATIONS ---
+#define D7S_DEFAULT_OPERATION_TIMEOUT 10000 //default deadline of initialize/selftest/acquireOffset [ms]
+#define D7S_OPERATION_POLL_INTERVAL 100 //minimum time between two STATE reads of pollOperation() [ms]
+#define D7S_OPERATION_START_WINDOW 1000 //if STATE never leaves NORMAL_MODE within this time the mode is assumed already over [ms]
+
+//--- BUS STATISTICS ---
+//the bus statistics (per register block and per public method) cost a few hundred bytes of RAM per instance,
+//uncomment this line to remove them
+//#define D7S_DISABLE_STATS
+
+//--- DEBUG ----
+//the register accesses and the interrupt edges can be recorded in a RAM ring: see D7S_TRACE in D7STrace.h
+
+
+//d7s state
+typedef enum d7s_status {
+   NORMAL_MODE = 0x00,
+   NORMAL_MODE_NOT_IN_STANBY = 0x01, //earthquake in progress
+   INITIAL_INSTALLATION_MODE = 0x02,
+   OFFSET_ACQUISITION_MODE = 0x03,
+   SELFTEST_MODE = 0x04
+} d7s_status;
+
+//d7s axis settings
+typedef enum d7s_axis_settings {
+   FORCE_YZ = 0x00,
+   FORCE_XZ = 0x01,
+   FORXE_XY = 0x02,
+   AUTO_SWITCH = 0x03,
+   SWITCH_AT_INSTALLATION = 0x04 
+} d7s_axis_settings;
+
+//axis state
+typedef enum d7s_axis_state {
+   AXIS_YZ = 0x00,
+   AXIS_XZ = 0x01,
+   AXIS_XY = 0x02
+} d7s_axis_state;
+
+//d7s threshold settings
+typedef enum d7s_threshold {
+   THRESHOLD_HIGH = 0x00,
+   THRESHOLD_LOW = 0x01
+} d7s_threshold;
+
+//message status (selftes, offset acquisition)
+typedef enum d7s_mode_status {
+   D7S_OK = 0,
+   D7S_ERROR = 1
+} d7s_mode_status;
+
+//events handled externaly by the using using an handler (the d7s int1, int2 must be connected to interrupt pin)
+typedef enum d7s_interrupt_event {
+   START_EARTHQUAKE = 0, //INT 2
+   END_EARTHQUAKE = 1, //INT 2
+   SHUTOFF_EVENT = 2, //INT 1
+   COLLAPSE_EVENT = 3 //INT 1
+} d7s_interrupt_event;
+
+//status of a register access
+typedef enum d7s_bus_status {
+   D7S_BUS_OK = 0,
+   D7S_BUS_NACK_ADDRESS = 1, //the d7s did not answer (unplugged?)
+   D7S_BUS_NACK_DATA = 2, //the d7s refused a byte
+   D7S_BUS_SHORT_READ = 3, //the d7s sent less bytes than requested
+   D7S_BUS_TIMEOUT = 4, //the deadline expired
+   D7S_BUS_ERROR = 5, //other bus error
+   D7S_BUS_LOCKED = 6, //the bus was owned by someone else for longer than the bus lock timeout
+   D7S_BUS_NOT_SAMPLER = 7 //the acquisition task owns the sampling, the call was rejected (read the samples with readSample())
+} d7s_bus_status;
+
+//operations run by startOperation()
+typedef enum d7s_operation {
+   D7S_OPERATION_NONE = 0,
+   D7S_OPERATION_INITIALIZE = 1, //initial installation mode
+   D7S_OPERATION_SELFTEST = 2, //self-diagnostic test
+   D7S_OPERATION_ACQUIRE_OFFSET = 3 //offset acquisition
+} d7s_operation;
+
+//status of the operation started by startOperation()
+typedef enum d7s_operation_status {
+   D7S_OPERATION_IDLE = 0, //no operation started
+   D7S_OPERATION_RUNNING = 1, //the d7s is still in the mode, keep calling pollOperation()
+   D7S_OPERATION_DONE = 2, //completed (and, for selftest/offset acquisition, the d7s reported OK)
+   D7S_OPERATION_FAILED = 3, //completed but the d7s reported an error
+   D7S_OPERATION_TIMEOUT = 4, //the d7s did not go back to normal mode before the deadline
+   D7S_OPERATION_BUS_ERROR = 5 //the d7s refused the mode command, or the deadline expired while it did not answer
+} d7s_operation_status;
+
+//called by pollOperation() when an operation completes
+typedef void (*d7s_operation_callback)(d7s_operation operation, d7s_operation_status status, void *ctx);
+
+//value read from a register together with the status of the access (value is 0 on failure)
+template <typename T>
+struct D7SResult {
+   d7s_bus_status status;
+   T value;
+
+   bool ok() const { return status == D7S_BUS_OK; }
+};
+
+//earthquake record stored by the d7s (lastest data at 0x3000-0x3400, ranked data at 0x3500-0x3900)
+//the fields follow the register layout of a record block, so it can be filled with a single sequential read
+struct D7SRecord {
+   int16_t offsetX; //offset of the X axis at the time of the earthquake [raw]
+   int16_t offsetY; //offset of the Y axis at the time of the earthquake [raw]
+   int16_t offsetZ; //offset of the Z axis at the time of the earthquake [raw]
+   int16_t temperature; //temperature at the time of the earthquake [0.1 C]
+   uint16_t si; //SI value, exposed as PGV by getLastestPGV() [mm/s]
+   uint16_t pga; //PGA [mm/s^2]
+};
+
+//--- HISTORY ---
+#define D7S_HISTORY_SLOTS 5 //records in each of the lastest and ranked blocks
+
+//dump of the earthquake history stored by the d7s
+//zero it (D7SHistory history = {};) before the first updateHistory(), it can be kept across reboots to speed up the next sync
+struct D7SHistory {
+   D7SRecord latest[D7S_HISTORY_SLOTS]; //lastest records, 0 is the newest (0x3000-0x3400)
+   D7SRecord ranked[D7S_HISTORY_SLOTS]; //ranked records, 0 has the largest SI (0x3500-0x3900)
+   uint16_t changed; //slots changed by the last dump (bits 0-4 lastest, bits 5-9 ranked)
+   uint8_t reads; //records read from the d7s by the last dump
+   uint8_t valid; //true after a successful dump
+};
+
+//instantaneous sample of the d7s (state and instantaneous data taken together)
+struct D7SSnapshot {
+   d7s_status state; //STATE register
+   uint16_t si; //instantaneous SI value, exposed as PGV by getInstantaneusPGV() [mm/s]
+   uint16_t pga; //instantaneous PGA [mm/s^2]
+   uint32_t timestamp; //millis() when the sample was taken
+   d7s_bus_status status; //status of the read (the values are 0 on failure)
+};
+
+//--- EVENT DISPATCH ---
+#ifndef D7S_MAX_SUBSCRIBERS
+   #define D7S_MAX_SUBSCRIBERS 4 //subscribers of each event, the handlers set by registerInterruptEventHandler() included
+#endif
+
+class D7SClass;
+
+//payload of an event, filled once by processEvents() and shared by all the subscribers of the event
+struct D7SEvent {
+   d7s_interrupt_event event;
+   uint32_t timestamp; //millis() of the interrupt edge
+   D7SSnapshot snapshot; //state, SI and PGA read once for the event (check snapshot.status)
+   const D7SRecord *record; //END_EARTHQUAKE: record stored by the d7s for the earthquake (NULL for the other events or if the read failed)
+   const D7SEventStats *stats; //END_EARTHQUAKE: statistics of the earthquake (NULL for the other events)
+   D7SClass *sensor; //instance that raised the event
+};
+
+//subscriber of an event, ctx is the pointer given to subscribe()
+typedef void (*d7s_event_callback)(const D7SEvent &event, void *ctx);
+
+//public methods tracked by the bus statistics
+typedef enum d7s_api {
+   D7S_API_NONE = 0, //bus access outside of a public method
+   D7S_API_GET_STATE,
+   D7S_API_GET_AXIS_IN_USE,
+   D7S_API_SET_THRESHOLD,
+   D7S_API_SET_AXIS,
+   D7S_API_GET_LASTEST_PGV,
+   D7S_API_GET_LASTEST_PGA,
+   D7S_API_GET_LATEST_RECORD,
+   D7S_API_GET_RANKED_RECORD,
+   D7S_API_GET_INSTANTANEUS_PGV,
+   D7S_API_GET_INSTANTANEUS_PGA,
+   D7S_API_GET_INTENSITY,
+   D7S_API_GET_SNAPSHOT,
+   D7S_API_CLEAR, //all the clear*() methods
+   D7S_API_INITIALIZE,
+   D7S_API_SELFTEST,
+   D7S_API_GET_SELFTEST_RESULT,
+   D7S_API_ACQUIRE_OFFSET,
+   D7S_API_GET_ACQUIRE_OFFSET_RESULT,
+   D7S_API_IS_IN_COLLAPSE,
+   D7S_API_IS_IN_SHUTOFF,
+   D7S_API_RESET_EVENTS,
+   D7S_API_IS_EARTHQUAKE_OCCURING,
+   D7S_API_IS_READY,
+   D7S_API_PROCESS_EVENTS, //interrupt handling (int1/int2)
+   D7S_API_ACQUIRE_SAMPLE,
+   D7S_API_GET_LASTEST_TEMPERATURE,
+   D7S_API_READ_HISTORY,
+   D7S_API_UPDATE_HISTORY,
+   D7S_API_POLL_OPERATION,
+   D7S_API_COUNT
+} d7s_api;
+
+//register blocks tracked by the bus statistics
+typedef enum d7s_register_block {
+   D7S_BLOCK_STATUS = 0, //0x10xx (STATE, AXIS_STATE, EVENT, MODE, CTRL, CLEAR_COMMAND)
+   D7S_BLOCK_INSTANTANEOUS, //0x20xx
+   D7S_BLOCK_LATEST, //0x30xx-0x34xx
+   D7S_BLOCK_RANKED, //0x35xx-0x39xx
+   D7S_BLOCK_OTHER,
+   D7S_BLOCK_COUNT
+} d7s_register_block;
+
+//bus counters of a public method, of a register block or of the whole bus
+struct D7SBusCounters {
+   uint32_t calls; //calls of the public method (only for the per method counters)
+   uint32_t transactions; //register accesses
+   uint32_t bytes; //bytes on the wire, retries included
+   uint32_t retries;
+   uint32_t failures;
+   uint32_t busTime; //time blocked on the bus, retries and backoff included [us]
+};
+
+//bus statistics
+struct D7SBusStats {
+   D7SBusCounters total;
+   D7SBusCounters api[D7S_API_COUNT]; //indexed by d7s_api
+   D7SBusCounters block[D7S_BLOCK_COUNT]; //indexed by d7s_register_block
+};
+
+//cached copy of a status register
+struct D7SCachedRegister {
+   uint8_t value; //last value read
+   volatile uint8_t valid; //false until read, cleared by invalidateCache() and by the isr
+   uint32_t timestamp; //millis() of the read
+};
+
+//interrupt recorded by the isr and processed later by processEvents()
+struct D7SInterrupt {
+   uint8_t source; //1 = INT1, 2 = INT2
+   uint8_t level; //pin level right after the edge (INT2: LOW = earthquake started, HIGH = ended)
+   uint32_t timestamp; //millis() of the edge
+};
+
+//size of a record block on the d7s
+#define D7S_RECORD_SIZE 12
+
+
+//class D7S
+class D7SClass {
+
+   public: 
+
+      //--- CONSTRUCTOR/DESTROYER ---
+      #if defined(ARDUINO)
+         D7SClass(); //constructor (talks over WireD7S)
+         D7SClass(TwoWire &wire, int sda = -1, int scl = -1); //constructor (talks over the given Wire, on the given pins if supported by the board)
+      #endif
+      D7SClass(D7STransport &transport); //constructor (talks over the given transport)
+      ~D7SClass(); //detach the interrupts (and stop the acquisition task)
+
+      //--- BEGIN ---
+      void begin(uint32_t clock = D7S_I2C_STANDARD_MODE); //used to initialize Wire
+
+      //--- BUS ---
+      void setBusClock(uint32_t clock); //change the i2c bus clock (D7S_I2C_STANDARD_MODE or D7S_I2C_FAST_MODE)
+      uint32_t getLastBusLatency(); //return the duration of the last register access [us]
+      void setBusRetries(uint8_t retries, uint16_t backoff); //change the retry policy (retries after the first attempt, base backoff [us])
+      void setBusTimeout(uint16_t timeout); //change the deadline of a register access, retries included [ms]
+      d7s_bus_status getLastBusStatus(); //return the status of the last register access
+      uint32_t getBusRetries(); //return the number of retries since the last reset
+      uint32_t getBusFailures(); //return the number of failed register accesses since the last reset
+      void resetBusCounters(); //reset the retries/failures counters
+      D7STransport &getTransport(); //transport used to talk with the d7s
+      D7SBusLock &getBusLock(); //lock of the bus, take it (D7SBusTransaction) to group accesses or to talk to other devices on the same bus
+      void setBusLock(D7SBusLock &lock); //use a lock shared with other drivers instead of the one of the transport
+      void setBusLockTimeout(uint16_t timeout); //change the longest wait for the bus lock [ms]
+      #ifndef D7S_DISABLE_STATS
+         void getBusStats(D7SBusStats &stats); //copy the bus statistics (per register block and per public method)
+         void resetBusStats(); //reset the bus statistics
+      #endif
+
+      //--- REGISTER CACHE ---
+      void setCacheWindow(uint16_t window); //change how long STATE, AXIS_STATE and EVENT are served from the cache [ms] (0 = always read)
+      void invalidateCache(); //drop the cached STATE, AXIS_STATE, EVENT and CTRL values
+      void invalidateCache(uint8_t regL); //drop the cached value of a single register (D7S_REG_STATE, D7S_REG_AXIS_STATE or D7S_REG_EVENT)
+
+      //--- STATUS ---
+      d7s_status getState(); //return the currect state
+      d7s_axis_state getAxisInUse(); //return the current axis in use
+
+      //--- SETTINGS ---
+      void setThreshold(d7s_threshold threshold); //change the threshold in use
+      void setAxis(d7s_axis_settings axisMode); //change the axis selection mode
+
+      //--- LASTEST DATA ---
+      float getLastestPGV(uint8_t index); //get the lastest PGV at specified index (up to 5) [m/s]
+      float getLastestPGA(uint8_t index); //get the lastest PGA at specified index (up to 5) [m/s^2]
+      float getLastestTemperature(uint8_t index); //get the lastest temperature at specified index (up to 5) [C]
+      uint16_t getLastestPGVRaw(uint8_t index); //get the lastest PGV at specified index (up to 5) [mm/s]
+      uint16_t getLastestPGARaw(uint8_t index); //get the lastest PGA at specified index (up to 5) [mm/s^2]
+      int16_t getLastestTemperatureRaw(uint8_t index); //get the lastest temperature at specified index (up to 5) [0.1 C]
+      D7SRecord getLatestRecord(uint8_t index); //get the whole lastest record at specified index (up to 5) in one read
+
+      //--- RANKED DATA ---
+      D7SRecord getRankedRecord(uint8_t index); //get the whole ranked record at specified position (up to 5) in one read
+
+      //--- HISTORY ---
+      d7s_bus_status readHistory(D7SHistory &history); //read all the lastest and ranked records (10 block reads)
+      d7s_bus_status updateHistory(D7SHistory &history); //re-read only the records changed since the previous dump of history
+
+      //--- INSTANTANEUS DATA ---
+      float getInstantaneusPGV(); //get instantaneus PGV (during an earthquake) [m/s]
+      float getInstantaneusPGA(); //get instantaneus PGA (during an earthquake) [m/s^2]
+      uint16_t getInstantaneusPGVRaw(); //get instantaneus PGV (during an earthquake) [mm/s]
+      uint16_t getInstantaneusPGARaw(); //get instantaneus PGA (during an earthquake) [mm/s^2]
+      void setIntensityScale(uint8_t scale); //change the scale of getIntensity() and of the event statistics (D7S_SCALE_*, PHIVOLCS by default)
+      uint8_t getIntensityScale(); //return the scale of getIntensity()
+      uint8_t getIntensity(); //get the intensity of the earthquake (on the scale set by setIntensityScale())
+
+      //--- SNAPSHOT ---
+      D7SSnapshot getSnapshot(); //read state, instantaneous SI and PGA together
+      float getInstantaneusPGV(const D7SSnapshot &snapshot); //get the instantaneus PGV of a snapshot [m/s]
+      float getInstantaneusPGA(const D7SSnapshot &snapshot); //get the instantaneus PGA of a snapshot [m/s^2]
+      uint8_t getIntensity(const D7SSnapshot &snapshot); //get the intensity of a snapshot (no bus access)
+      uint8_t isEarthquakeOccuring(const D7SSnapshot &snapshot); //return true if an earthquake was occuring when the snapshot was taken
+      uint8_t isReady(const D7SSnapshot &snapshot); //return true if the d7s was ready when the snapshot was taken
+
+      //--- CLEAR MEMORY ---
+      void clearEarthquakeData(); //delete both the lastest data and the ranked data
+      void clearInstallationData(); //delete initializzazion data
+      void clearLastestOffsetData(); //delete offset data
+      void clearSelftestData(); //delete selftest data
+      void clearAllData(); //delete all data
+
+      //--- INITIALIZATION ---
+      void initialize(); //initialize the d7s (start the initial installation mode)
+
+      //--- SELFTEST ---
+      void selftest(); //trigger self-diagnostic test
+      d7s_mode_status getSelftestResult(); //return the result of self-diagnostic test (OK/ERROR)
+
+      //--- OFFSET ACQUISITION ---
+      void acquireOffset(); //trigger offset acquisition
+      d7s_mode_status getAcquireOffsetResult(); //return the result of offset acquisition test (OK/ERROR)
+
+      //--- SHUTOFF/COLLAPSE EVENT ---
+      //after each earthquakes it's important to reset the events calling resetEvents() to prevent polluting the new data with the old one
+      uint8_t isInCollapse(); //return true if the collapse condition is met (it's the sencond bit of _events)
+      uint8_t isInShutoff(); //return true if the shutoff condition is met (it's the first bit of _events)
+      void resetEvents(); //reset shutoff/collapse events
+
+      //--- EARTHQUAKE EVENT ---
+      uint8_t isEarthquakeOccuring(); //return true if an earthquake is occuring
+
+      //--- READY STATE ---
+      uint8_t isReady();
+
+      //--- ASYNCHRONOUS OPERATIONS ---
+      //start initialize/selftest/acquireOffset without blocking, then call pollOperation() until it is no longer D7S_OPERATION_RUNNING
+      //(the ESP32 acquisition task polls it, the callback is then called from that task)
+      bool startOperation(d7s_operation operation, uint32_t timeout = D7S_DEFAULT_OPERATION_TIMEOUT, d7s_operation_callback callback = NULL, void *ctx = NULL); //false if another operation is running or the mode command failed (status D7S_OPERATION_BUS_ERROR)
+      d7s_operation_status pollOperation(); //advance the running operation (at most one STATE read every D7S_OPERATION_POLL_INTERVAL) and return its status (only the status while the acquisition task runs, the task polls)
+      d7s_operation_status getOperationStatus(); //return the status of the last operation (no bus access)
+      d7s_operation getOperation(); //return the last operation started
+
+      //--- INTERRUPT ---
+      bool enableInterruptINT1(uint8_t pin); //enable interrupt INT1 on specified pin (false if no interrupt slot is left)
+      bool enableInterruptINT2(uint8_t pin); //enable interrupt INT2 on specified pin (false if no interrupt slot is left)
+      void startInterruptHandling(); //start interrupt handling
+      void stopInterruptHandling(); //stop interrupt handling
+      void registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) ()); //assing the handler to the specific event
+      void registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) (float, float, float)); //assing the handler to END_EARTHQUAKE (SI [m/s], PGA [m/s^2], temperature [C])
+      void registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) (const D7SEventStats &)); //assing the handler to END_EARTHQUAKE (statistics of the earthquake)
+      bool subscribe(d7s_interrupt_event event, d7s_event_callback callback, void *ctx = NULL); //add a subscriber to the event (false if the table of the event is full)
+      void unsubscribe(d7s_interrupt_event event, d7s_event_callback callback, void *ctx = NULL); //remove a subscriber from the event
+      uint8_t processEvents(); //do the bus work for the queued interrupts and call the handlers, return the number of interrupts processed (0 from other tasks while the acquisition task runs)
+      uint8_t getPendingEvents(); //return the number of interrupts waiting for processEvents()
+      uint32_t getDroppedEvents(); //return the number of interrupts lost because the queue was full
+
+      //--- ACQUISITION ---
+      //the sample ring has a single producer and the interrupt queue a single consumer: while the acquisition task runs,
+      //acquireSample() and processEvents() called from any other task are rejected (use readSample() and the handlers instead)
+      D7SSnapshot acquireSample(); //take a snapshot and append it to the sample ring (status D7S_BUS_NOT_SAMPLER if rejected)
+      D7SSampleCursor getSampleCursor(); //return a cursor positioned on the next sample that will be acquired
+      bool readSample(D7SSampleCursor &cursor, D7SSnapshot &snapshot); //copy the next sample of the cursor from the ring (no bus access), false if there is none
+      #if defined(ESP32)
+         bool startAcquisition(uint16_t rate, uint8_t core = D7S_ACQUISITION_CORE, uint8_t priority = D7S_ACQUISITION_PRIORITY); //start the acquisition task sampling at rate [Hz]
+         void stopAcquisition(); //stop the acquisition task
+         uint8_t isAcquiring(); //return true if the acquisition task is running
+      #endif
+
+      //--- CAPTURE ---
+      void setCapture(D7SCapture *capture); //attach a capture fed by acquireSample() and triggered by INT2 (NULL to detach)
+      uint16_t getCapturePeriod(); //return the fastest sustainable sampling period while a capture is triggered [ms]
+
+      //--- EVENT STATISTICS ---
+      const D7SEventStats &getEventStats(); //statistics of the current (or last) earthquake, updated by acquireSample()
+
+   private:
+      //bus used to talk with the d7s
+      D7STransport *_transport;
+      #if defined(ARDUINO)
+         static D7STransport *wireTransport(TwoWire &wire, int sda, int scl); //transport of a TwoWire bus (built once, shared by the Wire constructors)
+      #endif
+
+      #if !defined(D7S_INTERRUPT_ARG)
+         //instances that receive the interrupts of the slot isrs, and the slot of this instance (-1 = none)
+         static D7SClass *_interruptSlots[D7S_MAX_INSTANCES];
+         static void (*const _isr1Slots[D7S_MAX_INSTANCES])();
+         static void (*const _isr2Slots[D7S_MAX_INSTANCES])();
+         int8_t _interruptSlot;
+      #endif
+
+      //subscribers of each event, called in registration order (fixed tables, no allocation)
+      struct D7SSubscriber {
+         d7s_event_callback callback;
+         void *ctx;
+      };
+      D7SSubscriber _subscribers[4][D7S_MAX_SUBSCRIBERS];
+      uint8_t _subscriberCount[4];
+
+      //handlers set by registerInterruptEventHandler(), each one is a subscriber whose ctx points to its slot here
+      void (*_handlers[4]) ();
+      //END_EARTHQUAKE handlers with arguments
+      void (*_recordHandler) (float, float, float);
+      void (*_statsHandler) (const D7SEventStats &);
+
+      //variable to track event (first bit => SHUTOFF, second bit => COLLAPSE)
+      uint8_t _events;
+
+      //enable interrupt handling
+      uint8_t _interruptEnabled;
+
+      //interrupt queue (single producer: the isr, single consumer: processEvents())
+      D7SInterrupt _interruptQueue[D7S_INTERRUPT_QUEUE_SIZE];
+      volatile uint8_t _interruptHead; //written only by the isr
+      volatile uint8_t _interruptTail; //written only by processEvents()
+      volatile uint32_t _droppedInterrupts;
+
+      //pin connected to INT1
+      uint8_t _pinINT1;
+      uint8_t _int1Enabled;
+
+      //pin connected to INT2 (its level tells the start from the end of an earthquake)
+      uint8_t _pinINT2;
+      uint8_t _int2Enabled;
+
+      //true between a START_EARTHQUAKE and its END_EARTHQUAKE
+      uint8_t _earthquakeActive;
+
+      //true from a mode command (initialize/selftest/acquireOffset) until its INT2 edges are processed
+      uint8_t _modeInProgress;
+
+      //operation started by startOperation()
+      d7s_operation _operation;
+      d7s_operation_status _operationStatus;
+      d7s_operation_callback _operationCallback;
+      void *_operationContext;
+      uint32_t _operationStart; //millis() of the start
+      uint32_t _operationTimeout; //[ms]
+      uint32_t _operationLastPoll; //millis() of the last STATE read
+      uint8_t _operationEntered; //true once STATE left NORMAL_MODE
+
+      //samples acquired by acquireSample() (or by the acquisition task)
+      D7SSampleRing<D7SSnapshot> _samples;
+
+      //capture fed by acquireSample() and the bus time of the last sample [us]
+      D7SCapture *_capture;
+      uint32_t _sampleBusTime;
+
+      //statistics of the earthquake in progress, fed by acquireSample()
+      D7SEventAccumulator _eventStats;
+
+      //record of the last earthquake read at END_EARTHQUAKE (pointed by its payload)
+      D7SRecord _eventRecord;
+
+      #if defined(ESP32)
+         //acquisition task, and the task that owns the sampling (set by the task itself)
+         TaskHandle_t _acquisitionTask;
+         volatile TaskHandle_t _acquisitionOwner;
+         volatile uint8_t _acquisitionRunning;
+         uint32_t _acquisitionPeriod; //[ms]
+      #endif
+
+      //ownership of the bus and the longest wait for it [ms]
+      D7SBusLock *_busLock;
+      uint16_t _busLockTimeout;
+
+      #if defined(D7S_TRACE)
+         //number of the instance in the trace records
+         uint8_t _traceId;
+         static uint8_t _traceInstances;
+      #endif
+
+      //duration and status of the last register access
+      uint32_t _lastLatency;
+      d7s_bus_status _lastStatus;
+
+      //retry policy
+      uint8_t _busRetries;
+      uint16_t _busBackoff;
+      uint16_t _busTimeout;
+
+      //bus counters
+      uint32_t _busRetryCount;
+      uint32_t _busFailureCount;
+
+      #ifndef D7S_DISABLE_STATS
+         //bus statistics (updated only while the bus lock is held), the public method being executed is kept per task by D7SApiScope
+         D7SBusStats _stats;
+         d7s_api currentApi(); //public method the calling task is executing on this instance
+         friend class D7SApiScope;
+      #endif
+
+      //cache of STATE, AXIS_STATE and EVENT (indexed by the low address)
+      D7SCachedRegister _statusCache[3];
+      uint16_t _cacheWindow; //[ms]
+
+      //shadow copy of CTRL (write-through, only the d7s reset can change it behind our back)
+      uint8_t _ctrlShadow;
+      uint8_t _ctrlValid;
+
+      //intensity scale (D7S_SCALE_*)
+      uint8_t _intensityScale;
+
+      //--- READ ---
+      D7SResult<uint8_t> read8bit(uint8_t regH, uint8_t regL); //read 8 bit from the specified register
+      D7SResult<uint16_t> read16bit(uint8_t regH, uint8_t regL); //read 16 bit from the specified register
+      d7s_bus_status readBlock(uint8_t regH, uint8_t regL, uint8_t *data, uint8_t len); //read len consecutive bytes starting from the specified register
+      d7s_bus_status readBlockOnce(uint8_t regH, uint8_t regL, uint8_t *data, uint8_t len); //single attempt of readBlock
+      d7s_bus_status readRecord(uint8_t regH, D7SRecord &record); //read the record block starting at regH:0x00 (zeroed on failure)
+      static bool sameRecord(const D7SRecord &a, const D7SRecord &b); //return true if two records hold the same values
+
+      //--- WRITE ---
+      d7s_bus_status write8bit(uint8_t regH, uint8_t regL, uint8_t val); //write 8 bit to the register specified
+      d7s_bus_status write8bitOnce(uint8_t regH, uint8_t regL, uint8_t val); //single attempt of write8bit
+
+      //--- CONSTRUCTOR ---
+      void init(); //reset the state of the instance
+
+      //--- RETRY ---
+      bool waitRetry(uint8_t attempt, uint32_t start, d7s_bus_status &status); //wait the backoff before the next attempt, false if no attempts are left
+      void endTransaction(d7s_bus_status status, uint32_t start, uint8_t regH, uint16_t bytes, uint8_t retries); //update the bus counters at the end of a register access
+      static d7s_bus_status toBusStatus(uint8_t wireStatus); //convert the Wire.endTransmission() code to a bus status
+      #ifndef D7S_DISABLE_STATS
+         static d7s_register_block toRegisterBlock(uint8_t regH); //register block of a high address
+      #endif
+
+      //--- READ EVENTS ---
+      void readEvents(); //read the event (SHUTOFF/COLLAPSE) from the EVENT register
+
+      //--- CACHED REGISTERS ---
+      D7SResult<uint8_t> readStatusRegister(uint8_t regL); //read STATE, AXIS_STATE or EVENT, from the cache if fresh
+      D7SResult<uint8_t> readCtrl(); //return CTRL from the shadow copy, read it from the d7s the first time
+      d7s_bus_status writeCtrl(uint8_t val); //write CTRL and update the shadow copy (write-through)
+
+      //--- ASYNCHRONOUS OPERATIONS ---
+      d7s_operation_status finishOperation(d7s_operation_status status); //complete the running operation and call its callback
+
+      //--- EVENT HANDLER ---
+      void pushInterrupt(uint8_t source, uint8_t level); //record an interrupt in the queue (interrupt context)
+      bool int1(const D7SInterrupt &interrupt, D7SEvent &payload); //handle the INT1 events, true if payload has to be dispatched
+      bool int2(const D7SInterrupt &interrupt, D7SEvent &payload); //handle the INT2 events, true if payload has to be dispatched
+      d7s_bus_status writeMode(uint8_t mode); //write a mode command, return the status of this write
+      D7SResult<d7s_mode_status> readModeResult(d7s_operation operation); //read the result of a selftest or offset acquisition from EVENT
+      bool isSampler(); //false if the acquisition task runs and the caller is another task
+      bool prepareEvent(D7SEvent &payload, d7s_interrupt_event event, uint32_t timestamp); //fill the common part of the payload, false if the interrupt handling is disabled or the event has no subscribers
+      void dispatch(const D7SEvent &payload); //call the subscribers of the event
+      static void callHandler(const D7SEvent &event, void *ctx); //adapters of the handlers set by registerInterruptEventHandler()
+      static void callRecordHandler(const D7SEvent &event, void *ctx);
+      static void callStatsHandler(const D7SEvent &event, void *ctx);
+
+      //--- ACQUISITION TASK ---
+      #if defined(ESP32)
+         static void acquisitionTask(void *arg); //body of the acquisition task
+      #endif
+
+      //--- ISR HANDLER ---
+      bool attachIsr(uint8_t pin, uint8_t source, int mode); //attach the isr of this instance for INT1/INT2 to pin
+      void handleINT2(); //read the INT2 level and queue the edge (interrupt context)
+      #if defined(D7S_INTERRUPT_ARG)
+         static void isr1(void *arg); //it handle the FALLING event that occur to the INT1 D7S pin (glue routine)
+         static void isr2(void *arg); //it handle the CHANGE event thant occur to the INT2 D7S pin (glue routine)
+      #else
+         template <uint8_t slot> static void isr1Slot(); //isr1 of the instance in the slot (glue routine)
+         template <uint8_t slot> static void isr2Slot(); //isr2 of the instance in the slot (glue routine)
+      #endif
+
+};
+
+#ifndef D7S_DISABLE_STATS
+
+//charges the bus accesses of a public method to it (nested calls are charged to the outermost one)
+//scope of a public method: the outermost scope of each task charges its method with the bus accesses made inside it
+//(the acquisition task and loop() can be inside different methods of the same instance at the same time)
+class D7SApiScope {
+
+   public:
+      D7SApiScope(D7SClass *d7s, d7s_api api);
+      ~D7SApiScope();
+
+      static d7s_api current(D7SClass *d7s); //method of the innermost scope of the calling task on d7s (D7S_API_NONE if none)
+
+   private:
+      D7SClass *_d7s;
+      d7s_api _api;
+      bool _owner;
+      D7SApiScope *_previous; //scope of the calling task this one is nested in
+
+      //innermost scope of each task (of the only thread on boards without an RTOS)
+      #if defined(ESP32) || !defined(ARDUINO)
+         static thread_local D7SApiScope *_current;
+      #else
+         static D7SApiScope *_current;
+      #endif
+};
+
+#define D7S_API_SCOPE(api) D7SApiScope apiScope(this, api)
+
+#else
+
+#define D7S_API_SCOPE(api)
+
+#endif
+
+#if defined(ARDUINO)
+   extern D7SClass D7S;
+#endif
+
+#endif
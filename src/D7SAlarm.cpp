@@ -0,0 +1,69 @@
+#include "D7SAlarm.h"
+
+D7SAlarm::D7SAlarm(uint16_t threshold, uint8_t readings) {
+   configure(threshold, readings);
+}
+
+//change the strong reading threshold [mm/s^2] and the debounce [readings]
+void D7SAlarm::configure(uint16_t threshold, uint8_t readings) {
+   _threshold = threshold;
+   _readings = readings ? readings : 1;
+   reset();
+}
+
+//forget the earthquake in progress (the onset detector is reset too)
+void D7SAlarm::reset() {
+   _onset.reset();
+   _strongReadings = 0;
+   _detected = 0;
+   _raised = 0;
+}
+
+//feed a sample (occurring: the d7s is processing an earthquake), return the decisions taken
+uint8_t D7SAlarm::update(uint8_t occurring, uint16_t pga) {
+   uint8_t decisions = 0;
+
+   //detection: onset on the PGA stream, or the d7s itself
+   _onset.update(pga);
+   uint8_t detected = _onset.isTriggered() || occurring;
+   if (detected && !_detected) {
+      decisions |= D7S_ALARM_DETECTED;
+   } else if (!detected && _detected) {
+      decisions |= D7S_ALARM_ENDED;
+   }
+   _detected = detected;
+
+   //debounce of the strong readings, restarted by a weak one
+   if (detected && pga >= _threshold) {
+      if (_strongReadings < 0xFF) {
+         _strongReadings++;
+      }
+   } else {
+      _strongReadings = 0;
+   }
+
+   uint8_t raised = _strongReadings >= _readings;
+   if (raised && !_raised) {
+      decisions |= D7S_ALARM_RAISED;
+   } else if (!raised && _raised) {
+      decisions |= D7S_ALARM_CLEARED;
+   }
+   _raised = raised;
+
+   return decisions;
+}
+
+//return true while an earthquake is detected
+uint8_t D7SAlarm::isDetected() {
+   return _detected;
+}
+
+//return true while the alarm is on
+uint8_t D7SAlarm::isRaised() {
+   return _raised;
+}
+
+//onset detector, to tune its windows and ratios
+D7SOnset &D7SAlarm::getOnset() {
+   return _onset;
+}
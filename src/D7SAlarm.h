@@ -0,0 +1,46 @@
+#ifndef D7S_ALARM_H
+#define D7S_ALARM_H
+
+#include <stdint.h>
+
+#include "D7SOnset.h"
+
+//--- ALARM DEFAULTS ---
+#define D7S_ALARM_THRESHOLD 50 //PGA of a strong reading [mm/s^2] (0.05 m/s^2)
+#define D7S_ALARM_READINGS 3 //consecutive strong readings that raise the alarm
+
+//decisions taken on a sample (update() returns a mask of them)
+#define D7S_ALARM_DETECTED 0x01 //an earthquake was detected
+#define D7S_ALARM_ENDED 0x02 //the earthquake is over
+#define D7S_ALARM_RAISED 0x04 //the alarm went on
+#define D7S_ALARM_CLEARED 0x08 //the alarm went off
+
+//earthquake detection and alarm decision, with no I/O so the same code runs on the node and in the replay tool
+//an earthquake is detected when the STA/LTA onset triggers on the PGA or when the d7s reports one (STATE/INT2),
+//during the earthquake the alarm is raised after D7S_ALARM_READINGS consecutive readings at or above the threshold
+//and cleared by the first weaker reading or by the end of the earthquake
+class D7SAlarm {
+
+   public:
+
+      D7SAlarm(uint16_t threshold = D7S_ALARM_THRESHOLD, uint8_t readings = D7S_ALARM_READINGS);
+
+      void configure(uint16_t threshold, uint8_t readings); //change the strong reading threshold [mm/s^2] and the debounce [readings]
+      void reset(); //forget the earthquake in progress (the onset detector is reset too)
+
+      uint8_t update(uint8_t occurring, uint16_t pga); //feed a sample (occurring: the d7s is processing an earthquake), return the decisions taken
+      uint8_t isDetected(); //return true while an earthquake is detected
+      uint8_t isRaised(); //return true while the alarm is on
+      D7SOnset &getOnset(); //onset detector, to tune its windows and ratios
+
+   private:
+
+      D7SOnset _onset;
+      uint16_t _threshold;
+      uint8_t _readings;
+      uint8_t _strongReadings; //consecutive readings at or above the threshold
+      uint8_t _detected;
+      uint8_t _raised;
+};
+
+#endif
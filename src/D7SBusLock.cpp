@@ -0,0 +1,123 @@
+#include "D7SBusLock.h"
+
+#include "D7SPlatform.h"
+
+D7SBusLock::D7SBusLock() {
+   #if defined(ESP32)
+      //static storage: no heap, and it can be created before the scheduler starts
+      _mutex = xSemaphoreCreateRecursiveMutexStatic(&_mutexBuffer);
+      _eventWaiters = 0;
+   #else
+      _depth = 0;
+   #endif
+   _contentions = 0;
+   _timeouts = 0;
+}
+
+D7SBusLock::~D7SBusLock() {
+   #if defined(ESP32)
+      vSemaphoreDelete(_mutex);
+   #endif
+}
+
+#if defined(ESP32)
+
+//return true if the calling task holds the bus
+bool D7SBusLock::isOwner() {
+   return xSemaphoreGetMutexHolder(_mutex) == xTaskGetCurrentTaskHandle();
+}
+
+//take the bus, false if it was not free within timeout [ms]
+bool D7SBusLock::lock(uint32_t timeout, d7s_bus_priority priority) {
+   //nested lock of the owner: never waits
+   if (isOwner()) {
+      return xSemaphoreTakeRecursive(_mutex, 0) == pdTRUE;
+   }
+
+   uint32_t start = millis();
+   bool waited = false;
+   bool taken;
+   if (priority == D7S_BUS_PRIORITY_EVENT) {
+      //announce the request so the normal ones step aside
+      __sync_fetch_and_add(&_eventWaiters, 1);
+      taken = xSemaphoreTakeRecursive(_mutex, 0) == pdTRUE;
+      if (!taken) {
+         waited = true;
+         taken = xSemaphoreTakeRecursive(_mutex, pdMS_TO_TICKS(timeout)) == pdTRUE;
+      }
+      __sync_fetch_and_sub(&_eventWaiters, 1);
+   } else {
+      //give way to the event requests (the mutex already queues the waiters by task priority)
+      while (_eventWaiters > 0 && millis() - start < timeout) {
+         waited = true;
+         vTaskDelay(1);
+      }
+      taken = xSemaphoreTakeRecursive(_mutex, 0) == pdTRUE;
+      if (!taken) {
+         waited = true;
+         uint32_t elapsed = millis() - start;
+         if (elapsed < timeout) {
+            taken = xSemaphoreTakeRecursive(_mutex, pdMS_TO_TICKS(timeout - elapsed)) == pdTRUE;
+         }
+      }
+   }
+
+   if (waited) {
+      _contentions++;
+   }
+   if (!taken) {
+      _timeouts++;
+   }
+   return taken;
+}
+
+//release the bus (once per successful lock())
+void D7SBusLock::unlock() {
+   xSemaphoreGiveRecursive(_mutex);
+}
+
+#else
+
+//take the bus, false if it was not free within timeout [ms]
+bool D7SBusLock::lock(uint32_t timeout, d7s_bus_priority priority) {
+   //single thread: the bus is always free for the caller
+   (void) timeout;
+   (void) priority;
+   _depth++;
+   return true;
+}
+
+//release the bus (once per successful lock())
+void D7SBusLock::unlock() {
+   if (_depth > 0) {
+      _depth--;
+   }
+}
+
+#endif
+
+//lock() calls that had to wait for another owner
+uint32_t D7SBusLock::getContentions() {
+   return _contentions;
+}
+
+//lock() calls that gave up
+uint32_t D7SBusLock::getTimeouts() {
+   return _timeouts;
+}
+
+D7SBusTransaction::D7SBusTransaction(D7SBusLock &lock, d7s_bus_priority priority, uint32_t timeout) {
+   _lock = &lock;
+   _owned = lock.lock(timeout, priority);
+}
+
+D7SBusTransaction::~D7SBusTransaction() {
+   if (_owned) {
+      _lock->unlock();
+   }
+}
+
+//return true if the bus is owned by the scope
+bool D7SBusTransaction::ok() {
+   return _owned;
+}
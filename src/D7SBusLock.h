@@ -0,0 +1,70 @@
+#ifndef D7S_BUS_LOCK_H
+#define D7S_BUS_LOCK_H
+
+#include <stdint.h>
+
+#if defined(ESP32)
+   #include <freertos/FreeRTOS.h>
+   #include <freertos/semphr.h>
+   #include <freertos/task.h>
+#endif
+
+//--- BUS LOCK ---
+#define D7S_BUS_LOCK_TIMEOUT 100 //longest wait for the bus before giving up [ms]
+
+//who is asking for the bus
+typedef enum d7s_bus_priority {
+   D7S_BUS_PRIORITY_NORMAL = 0, //sampling, settings, application code
+   D7S_BUS_PRIORITY_EVENT = 1 //interrupt handling: normal requests wait while one of these is waiting
+} d7s_bus_priority;
+
+//ownership of a shared i2c bus
+//recursive: the owner can take it again (a transaction scope around register accesses that lock it too),
+//bounded: lock() gives up after the timeout, prioritized: a normal request does not take the bus while an event request waits
+//on ESP32 it is a FreeRTOS recursive mutex (with priority inheritance), elsewhere there is a single thread and it only counts
+class D7SBusLock {
+
+   public:
+
+      D7SBusLock();
+      ~D7SBusLock();
+
+      bool lock(uint32_t timeout = D7S_BUS_LOCK_TIMEOUT, d7s_bus_priority priority = D7S_BUS_PRIORITY_NORMAL); //take the bus, false if it was not free within timeout [ms]
+      void unlock(); //release the bus (once per successful lock())
+      uint32_t getContentions(); //lock() calls that had to wait for another owner
+      uint32_t getTimeouts(); //lock() calls that gave up
+
+   private:
+
+      #if defined(ESP32)
+         SemaphoreHandle_t _mutex;
+         StaticSemaphore_t _mutexBuffer;
+         volatile uint32_t _eventWaiters; //event requests waiting for the bus
+         bool isOwner(); //return true if the calling task holds the bus
+      #else
+         uint16_t _depth; //nested lock() calls
+      #endif
+
+      volatile uint32_t _contentions;
+      volatile uint32_t _timeouts;
+};
+
+//scope owning the bus: groups several register accesses (e.g. a status check followed by a data read) in one ownership window
+//   D7SBusTransaction transaction(D7S.getBusLock());
+//   if (transaction.ok()) { ... }
+class D7SBusTransaction {
+
+   public:
+
+      D7SBusTransaction(D7SBusLock &lock, d7s_bus_priority priority = D7S_BUS_PRIORITY_NORMAL, uint32_t timeout = D7S_BUS_LOCK_TIMEOUT);
+      ~D7SBusTransaction();
+
+      bool ok(); //return true if the bus is owned by the scope
+
+   private:
+
+      D7SBusLock *_lock;
+      bool _owned;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "D7SCapture.h"
+
+#include <stddef.h>
+
+D7SCapture::D7SCapture() {
+   rearm();
+}
+
+//--- CONTROL ---
+
+//drop the capture and start collecting the pre-trigger samples again
+void D7SCapture::rearm() {
+   _count = 0;
+   _pretriggerHead = 0;
+   _trigger = 0;
+   _triggerTime = 0;
+   _endTime = 0;
+   _truncated = 0;
+   __sync_synchronize();
+   _state = D7S_CAPTURE_ARMED;
+}
+
+//return the state of the capture
+d7s_capture_state D7SCapture::getState() {
+   return (d7s_capture_state) _state;
+}
+
+//return true while an earthquake is being captured
+uint8_t D7SCapture::isTriggered() {
+   return _state == D7S_CAPTURE_TRIGGERED;
+}
+
+//return the complete capture (an empty span if it is not complete)
+D7SCaptureSpan D7SCapture::getCapture() {
+   D7SCaptureSpan span;
+   if (_state != D7S_CAPTURE_COMPLETE) {
+      span.samples = NULL;
+      span.count = 0;
+      span.trigger = 0;
+      span.triggerTime = 0;
+      span.endTime = 0;
+      span.truncated = 0;
+      return span;
+   }
+   __sync_synchronize();
+   span.samples = _buffer;
+   span.count = _count;
+   span.trigger = _trigger;
+   span.triggerTime = _triggerTime;
+   span.endTime = _endTime;
+   span.truncated = _truncated;
+   return span;
+}
+
+//--- FEED ---
+
+//append a sample (ignored once complete)
+void D7SCapture::add(uint32_t timestamp, uint16_t si, uint16_t pga) {
+   D7SCaptureSample *sample;
+
+   if (_state == D7S_CAPTURE_ARMED) {
+      //pre-trigger ring
+      sample = &_buffer[_pretriggerHead];
+      _pretriggerHead = (_pretriggerHead + 1) % D7S_CAPTURE_PRETRIGGER;
+      if (_count < D7S_CAPTURE_PRETRIGGER) {
+         _count++;
+      }
+   } else if (_state == D7S_CAPTURE_TRIGGERED) {
+      //event samples, counted but dropped once the buffer is full
+      if (_count >= D7S_CAPTURE_SIZE) {
+         _truncated++;
+         return;
+      }
+      sample = &_buffer[_count++];
+   } else {
+      return;
+   }
+
+   sample->timestamp = timestamp;
+   sample->si = si;
+   sample->pga = pga;
+}
+
+//the earthquake started (ignored unless armed)
+void D7SCapture::trigger(uint32_t timestamp) {
+   if (_state != D7S_CAPTURE_ARMED) {
+      return;
+   }
+   //once the ring wrapped its oldest sample is at the head, rotate it to the start of the buffer
+   //(rotation by three reversals, done once per event and without a second buffer)
+   if (_count == D7S_CAPTURE_PRETRIGGER && _pretriggerHead != 0) {
+      reverse(0, _pretriggerHead - 1);
+      reverse(_pretriggerHead, D7S_CAPTURE_PRETRIGGER - 1);
+      reverse(0, D7S_CAPTURE_PRETRIGGER - 1);
+   }
+   _trigger = _count;
+   _triggerTime = timestamp;
+   _state = D7S_CAPTURE_TRIGGERED;
+}
+
+//the earthquake ended (ignored unless triggered)
+void D7SCapture::finish(uint32_t timestamp) {
+   if (_state != D7S_CAPTURE_TRIGGERED) {
+      return;
+   }
+   _endTime = timestamp;
+   //publish the samples before the state
+   __sync_synchronize();
+   _state = D7S_CAPTURE_COMPLETE;
+}
+
+//reverse the samples between first and last (included)
+void D7SCapture::reverse(uint16_t first, uint16_t last) {
+   while (first < last) {
+      D7SCaptureSample sample = _buffer[first];
+      _buffer[first++] = _buffer[last];
+      _buffer[last--] = sample;
+   }
+}
@@ -0,0 +1,76 @@
+#ifndef D7S_CAPTURE_H
+#define D7S_CAPTURE_H
+
+#include <stdint.h>
+
+//--- CAPTURE BUFFER ---
+#ifndef D7S_CAPTURE_PRETRIGGER
+   #define D7S_CAPTURE_PRETRIGGER 32 //samples kept before the trigger
+#endif
+#ifndef D7S_CAPTURE_SIZE
+   #define D7S_CAPTURE_SIZE 512 //samples of a capture, pre-trigger included
+#endif
+#define D7S_CAPTURE_MIN_PERIOD 10 //fastest sampling period while triggered, the d7s does not update the instantaneous data faster [ms]
+
+//state of a capture
+typedef enum d7s_capture_state {
+   D7S_CAPTURE_ARMED = 0, //collecting the pre-trigger samples
+   D7S_CAPTURE_TRIGGERED = 1, //earthquake in progress, collecting the event samples
+   D7S_CAPTURE_COMPLETE = 2 //earthquake ended, the samples are available until rearm()
+} d7s_capture_state;
+
+//sample of a capture
+struct D7SCaptureSample {
+   uint32_t timestamp; //millis() when the sample was taken
+   uint16_t si; //instantaneous SI [mm/s]
+   uint16_t pga; //instantaneous PGA [mm/s^2]
+};
+
+//view of a complete capture (points into the capture buffer, nothing is copied)
+struct D7SCaptureSpan {
+   const D7SCaptureSample *samples; //samples in chronological order (NULL if the capture is not complete)
+   uint16_t count; //number of samples
+   uint16_t trigger; //index of the first sample taken after the trigger (the ones before are the pre-trigger)
+   uint32_t triggerTime; //millis() of the trigger
+   uint32_t endTime; //millis() of the end of the earthquake
+   uint32_t truncated; //event samples lost because the buffer was full
+};
+
+//event-triggered capture of the instantaneous data with pre-trigger history
+//while armed the last D7S_CAPTURE_PRETRIGGER samples are kept in a ring at the start of the buffer,
+//on the trigger the ring is put in chronological order in place and the event samples are appended after it,
+//at the end of the earthquake the buffer is frozen until rearm()
+//the buffer is preallocated, feed it from a single task (D7SClass does it from acquireSample() and processEvents())
+class D7SCapture {
+
+   public:
+
+      D7SCapture();
+
+      //--- CONTROL ---
+      void rearm(); //drop the capture and start collecting the pre-trigger samples again
+      d7s_capture_state getState(); //return the state of the capture
+      uint8_t isTriggered(); //return true while an earthquake is being captured
+      D7SCaptureSpan getCapture(); //return the complete capture (an empty span if it is not complete)
+
+      //--- FEED ---
+      void add(uint32_t timestamp, uint16_t si, uint16_t pga); //append a sample (ignored once complete)
+      void trigger(uint32_t timestamp); //the earthquake started (ignored unless armed)
+      void finish(uint32_t timestamp); //the earthquake ended (ignored unless triggered)
+
+   private:
+
+      //reverse the samples between first and last (included)
+      void reverse(uint16_t first, uint16_t last);
+
+      D7SCaptureSample _buffer[D7S_CAPTURE_SIZE];
+      volatile uint8_t _state;
+      uint16_t _count; //samples in the buffer (pre-trigger ring included)
+      uint16_t _pretriggerHead; //next slot of the pre-trigger ring
+      uint16_t _trigger;
+      uint32_t _triggerTime;
+      uint32_t _endTime;
+      uint32_t _truncated;
+};
+
+#endif
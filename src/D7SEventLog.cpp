@@ -0,0 +1,388 @@
+#include "D7SEventLog.h"
+#include "D7STelemetry.h"
+
+//--- CODING ---
+
+static void put16(uint8_t *raw, uint16_t value) {
+   raw[0] = value & 0xFF;
+   raw[1] = value >> 8;
+}
+
+static void put32(uint8_t *raw, uint32_t value) {
+   put16(raw, value & 0xFFFF);
+   put16(raw + 2, value >> 16);
+}
+
+static uint16_t get16(const uint8_t *raw) {
+   return raw[0] | (raw[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *raw) {
+   return get16(raw) | (((uint32_t) get16(raw + 2)) << 16);
+}
+
+//pack a record in D7S_LOG_RECORD_SIZE bytes (little endian, CRC-16 of the first 30 bytes at the end)
+void D7SEventLog::encode(const D7SLogRecord &record, uint8_t *raw) {
+   memset(raw, 0, D7S_LOG_RECORD_SIZE);
+   raw[0] = D7S_LOG_MAGIC;
+   raw[1] = record.flags;
+   put32(raw + 2, record.sequence);
+   put32(raw + 6, record.time);
+   put32(raw + 10, record.duration);
+   put16(raw + 14, record.si);
+   put16(raw + 16, record.pga);
+   put16(raw + 18, (uint16_t) record.temperature);
+   raw[20] = record.intensity;
+   put16(raw + 22, record.samples);
+   //bytes 24-29 are reserved (0)
+   put16(raw + 30, d7sCrc16(raw, D7S_LOG_RECORD_SIZE - 2));
+}
+
+//unpack a record, false if it is erased or corrupted
+bool D7SEventLog::decode(const uint8_t *raw, D7SLogRecord &record) {
+   if (raw[0] != D7S_LOG_MAGIC || get16(raw + 30) != d7sCrc16(raw, D7S_LOG_RECORD_SIZE - 2)) {
+      return false;
+   }
+   record.flags = raw[1];
+   record.sequence = get32(raw + 2);
+   record.time = get32(raw + 6);
+   record.duration = get32(raw + 10);
+   record.si = get16(raw + 14);
+   record.pga = get16(raw + 16);
+   record.temperature = (int16_t) get16(raw + 18);
+   record.intensity = raw[20];
+   record.samples = get16(raw + 22);
+   return true;
+}
+
+//return true if the slot was never written since its sector was erased
+static bool isErased(const uint8_t *raw) {
+   for (uint8_t i = 0; i < D7S_LOG_RECORD_SIZE; i++) {
+      if (raw[i] != 0xFF) {
+         return false;
+      }
+   }
+   return true;
+}
+
+//--- PARTITION STORAGE ---
+#if defined(ESP32)
+
+D7SPartitionStorage::D7SPartitionStorage(const char *label) {
+   _label = label;
+   _partition = NULL;
+}
+
+//find the partition, false if it does not exist
+bool D7SPartitionStorage::begin() {
+   _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, _label);
+   return _partition != NULL;
+}
+
+uint32_t D7SPartitionStorage::capacity() {
+   return _partition ? _partition->size - _partition->size % SPI_FLASH_SEC_SIZE : 0;
+}
+
+uint32_t D7SPartitionStorage::sectorSize() {
+   return SPI_FLASH_SEC_SIZE;
+}
+
+bool D7SPartitionStorage::read(uint32_t offset, uint8_t *data, uint32_t len) {
+   return _partition && esp_partition_read(_partition, offset, data, len) == ESP_OK;
+}
+
+bool D7SPartitionStorage::write(uint32_t offset, const uint8_t *data, uint32_t len) {
+   return _partition && esp_partition_write(_partition, offset, data, len) == ESP_OK;
+}
+
+bool D7SPartitionStorage::erase(uint32_t offset) {
+   return _partition && esp_partition_erase_range(_partition, offset, SPI_FLASH_SEC_SIZE) == ESP_OK;
+}
+
+#endif
+
+//--- EVENT LOG ---
+
+D7SEventLog::D7SEventLog(D7SLogStorage &storage) {
+   _storage = &storage;
+   _slots = 0;
+   _slotsPerSector = 0;
+   _first = 0;
+   _count = 0;
+   _nextSequence = 0;
+   _dropped = 0;
+   _scale = D7S_SCALE_PHIVOLCS;
+   _queueHead = 0;
+   _queueTail = 0;
+   #if defined(ESP32)
+      portMUX_INITIALIZE(&_queueLock);
+   #endif
+}
+
+//scan the storage to find the end of the log, false if the storage is not usable
+bool D7SEventLog::begin() {
+   uint32_t sector = _storage->sectorSize();
+   if (sector < D7S_LOG_RECORD_SIZE || sector % D7S_LOG_RECORD_SIZE || _storage->capacity() < 2 * sector) {
+      return false;
+   }
+   _slotsPerSector = sector / D7S_LOG_RECORD_SIZE;
+   _slots = _storage->capacity() / sector * _slotsPerSector;
+
+   //the newest record has the highest sequence
+   uint8_t raw[D7S_LOG_RECORD_SIZE];
+   D7SLogRecord record;
+   bool found = false;
+   uint32_t last = 0;
+   for (uint32_t slot = 0; slot < _slots; slot++) {
+      if (_storage->read(slot * D7S_LOG_RECORD_SIZE, raw, D7S_LOG_RECORD_SIZE) && decode(raw, record)) {
+         if (!found || record.sequence >= _nextSequence) {
+            _nextSequence = record.sequence + 1;
+            last = slot;
+            found = true;
+         }
+      }
+   }
+
+   //empty log
+   if (!found) {
+      _first = 0;
+      _count = 0;
+      return true;
+   }
+
+   //a slot that is not erased after the newest record is a torn write, continue from the next sector
+   uint32_t end = (last + 1) % _slots;
+   if (end % _slotsPerSector != 0) {
+      if (!_storage->read(end * D7S_LOG_RECORD_SIZE, raw, D7S_LOG_RECORD_SIZE) || !isErased(raw)) {
+         end = (end / _slotsPerSector + 1) * _slotsPerSector % _slots;
+      }
+   }
+
+   //the log wrapped if the sector after the end holds records, the oldest ones
+   uint32_t next = end % _slotsPerSector == 0 ? end : (end / _slotsPerSector + 1) * _slotsPerSector % _slots;
+   bool wrapped = false;
+   for (uint32_t slot = next; slot < next + _slotsPerSector && !wrapped; slot++) {
+      wrapped = _storage->read(slot * D7S_LOG_RECORD_SIZE, raw, D7S_LOG_RECORD_SIZE) && decode(raw, record);
+   }
+   if (wrapped) {
+      _first = next;
+      _count = (end + _slots - next) % _slots;
+      if (_count == 0) {
+         _count = _slots;
+      }
+   } else {
+      _first = 0;
+      _count = end == 0 ? _slots : end;
+   }
+   return true;
+}
+
+//--- WRITE ---
+
+//queue a record (the sequence is assigned here), false if the queue is full
+bool D7SEventLog::append(const D7SLogRecord &record) {
+   //several tasks (or the handlers of several sensors) can append: the sequence and the slot are taken atomically
+   #if defined(ESP32)
+      portENTER_CRITICAL(&_queueLock);
+   #else
+      noInterrupts();
+   #endif
+   bool queued = (uint8_t) (_queueHead - _queueTail) < D7S_LOG_QUEUE_SIZE;
+   if (queued) {
+      uint8_t index = _queueHead & (D7S_LOG_QUEUE_SIZE - 1);
+      _queue[index] = record;
+      _queue[index].sequence = _nextSequence++;
+      _queueTime[index] = millis();
+      //publish the slot to flush()
+      __sync_synchronize();
+      _queueHead++;
+   } else {
+      _dropped++;
+   }
+   #if defined(ESP32)
+      portEXIT_CRITICAL(&_queueLock);
+   #else
+      interrupts();
+   #endif
+   return queued;
+}
+
+//scale of the intensity of the summaries (D7S_SCALE_*), the records already written keep theirs
+void D7SEventLog::setScale(uint8_t scale) {
+   _scale = scale;
+}
+
+//queue the summary of a d7s record (END_EARTHQUAKE data)
+bool D7SEventLog::appendRecord(const D7SRecord &record, uint32_t time, uint8_t flags) {
+   D7SLogRecord entry;
+   entry.time = time;
+   entry.duration = 0;
+   entry.si = record.si;
+   entry.pga = record.pga;
+   entry.temperature = record.temperature;
+   entry.intensity = d7sIntensity(record.si, record.pga, _scale);
+   entry.flags = flags;
+   entry.samples = 0;
+   return append(entry);
+}
+
+//queue the summary of a complete capture (peaks and duration from the time history)
+bool D7SEventLog::appendCapture(const D7SCaptureSpan &span, uint32_t time, int16_t temperature, uint8_t flags) {
+   if (span.samples == NULL) {
+      return false;
+   }
+   D7SLogRecord entry;
+   entry.time = time;
+   entry.duration = span.endTime - span.triggerTime;
+   entry.si = 0;
+   entry.pga = 0;
+   for (uint16_t i = span.trigger; i < span.count; i++) {
+      if (span.samples[i].si > entry.si) {
+         entry.si = span.samples[i].si;
+      }
+      if (span.samples[i].pga > entry.pga) {
+         entry.pga = span.samples[i].pga;
+      }
+   }
+   entry.temperature = temperature;
+   entry.intensity = d7sIntensity(entry.si, entry.pga, _scale);
+   entry.flags = flags | D7S_LOG_CAPTURE | (span.truncated ? D7S_LOG_TRUNCATED : 0);
+   entry.samples = span.count;
+   return append(entry);
+}
+
+//--- FLUSH ---
+
+//write the queue if a batch is ready or the oldest record waited too long, return the records written
+uint8_t D7SEventLog::service() {
+   uint8_t pending = _queueHead - _queueTail;
+   if (pending == 0) {
+      return 0;
+   }
+   if (pending < D7S_LOG_BATCH && millis() - _queueTime[_queueTail & (D7S_LOG_QUEUE_SIZE - 1)] < D7S_LOG_FLUSH_INTERVAL) {
+      return 0;
+   }
+   return flush();
+}
+
+//write all the queued records now, return the records written
+uint8_t D7SEventLog::flush() {
+   uint8_t pending = _queueHead - _queueTail;
+   if (pending == 0 || _slots == 0) {
+      return 0;
+   }
+   __sync_synchronize();
+   if (!writeRecords(pending)) {
+      //the records stay queued, the next flush retries on a fresh sector
+      return 0;
+   }
+   _storage->sync();
+   return pending;
+}
+
+//write count queued records at the end of the log
+//contiguous records of a sector go in a single write, a sector is erased when the log enters it
+bool D7SEventLog::writeRecords(uint32_t count) {
+   uint8_t buffer[D7S_LOG_QUEUE_SIZE * D7S_LOG_RECORD_SIZE];
+
+   while (count > 0) {
+      uint32_t end = (_first + _count) % _slots;
+
+      //entering a sector: erase it, dropping the oldest records if the log is full
+      if (end % _slotsPerSector == 0) {
+         if (_count + _slotsPerSector > _slots) {
+            _first = (_first + _slotsPerSector) % _slots;
+            _count -= _slotsPerSector;
+         }
+         if (!_storage->erase(end * D7S_LOG_RECORD_SIZE)) {
+            return false;
+         }
+      }
+
+      //records that fit in the rest of the sector
+      uint32_t room = _slotsPerSector - end % _slotsPerSector;
+      uint32_t batch = count < room ? count : room;
+      for (uint32_t i = 0; i < batch; i++) {
+         encode(_queue[(_queueTail + i) & (D7S_LOG_QUEUE_SIZE - 1)], &buffer[i * D7S_LOG_RECORD_SIZE]);
+      }
+      if (!_storage->write(end * D7S_LOG_RECORD_SIZE, buffer, batch * D7S_LOG_RECORD_SIZE)) {
+         //the sector may hold a partial write, the next records go to the next sector
+         _count += room;
+         return false;
+      }
+
+      //release the written records to append()
+      _count += batch;
+      __sync_synchronize();
+      _queueTail += batch;
+      count -= batch;
+   }
+   return true;
+}
+
+//--- READ ---
+
+//record slots in the log, oldest to newest (slots skipped after a torn write included)
+uint32_t D7SEventLog::size() {
+   return _count;
+}
+
+//records lost because the queue was full
+uint32_t D7SEventLog::getDropped() {
+   return _dropped;
+}
+
+//offset of the index-th record (0 is the oldest)
+uint32_t D7SEventLog::slotOffset(uint32_t index) {
+   return ((_first + index) % _slots) * D7S_LOG_RECORD_SIZE;
+}
+
+//read the index-th record (0 is the oldest), false if it is not valid
+bool D7SEventLog::get(uint32_t index, D7SLogRecord &record) {
+   uint8_t raw[D7S_LOG_RECORD_SIZE];
+   if (index >= _count) {
+      return false;
+   }
+   return _storage->read(slotOffset(index), raw, D7S_LOG_RECORD_SIZE) && decode(raw, record);
+}
+
+//visit the records with from <= time <= to and intensity >= minIntensity, oldest first, return how many matched
+//the first record is found with a binary search on the time, then the log is scanned until the time passes to
+uint32_t D7SEventLog::query(uint32_t from, uint32_t to, uint8_t minIntensity, void (*visit)(const D7SLogRecord &record, void *ctx), void *ctx) {
+   D7SLogRecord record;
+
+   //first index with time >= from (invalid slots are skipped forward)
+   uint32_t low = 0;
+   uint32_t high = _count;
+   while (low < high) {
+      uint32_t mid = low + (high - low) / 2;
+      uint32_t probe = mid;
+      while (probe < high && !get(probe, record)) {
+         probe++;
+      }
+      if (probe == high) {
+         high = mid;
+      } else if (record.time < from) {
+         low = probe + 1;
+      } else {
+         high = mid;
+      }
+   }
+
+   uint32_t matched = 0;
+   for (uint32_t index = low; index < _count; index++) {
+      if (!get(index, record)) {
+         continue;
+      }
+      if (record.time > to) {
+         break;
+      }
+      if (record.intensity >= minIntensity) {
+         matched++;
+         if (visit) {
+            visit(record, ctx);
+         }
+      }
+   }
+   return matched;
+}
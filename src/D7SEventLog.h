@@ -0,0 +1,140 @@
+#ifndef D7S_EVENT_LOG_H
+#define D7S_EVENT_LOG_H
+
+#include "D7S.h"
+
+#if defined(ESP32)
+   #include <esp_partition.h>
+#endif
+
+//append-only log of earthquake summaries on a storage backend (flash partition on ESP32, mmap-ed file on Linux)
+//the storage is a ring of sectors holding fixed 32 byte records protected by a CRC-16:
+//records are appended in order, the oldest sector is erased when the log wraps, a torn record is skipped at begin()
+//append() only queues the record in RAM (never blocks, safe from any task or handler: it reserves the slot in a critical section),
+//flush()/service() write the queue in batches from a low priority context to limit flash wear
+
+//--- LOG ---
+#define D7S_LOG_RECORD_SIZE 32 //bytes of a record on the storage
+#define D7S_LOG_MAGIC 0xD7 //first byte of a record (erased flash reads 0xFF)
+#ifndef D7S_LOG_QUEUE_SIZE
+   #define D7S_LOG_QUEUE_SIZE 8 //records waiting for flush() (power of two)
+#endif
+static_assert(D7S_LOG_QUEUE_SIZE > 0 && (D7S_LOG_QUEUE_SIZE & (D7S_LOG_QUEUE_SIZE - 1)) == 0, "D7S_LOG_QUEUE_SIZE must be a power of two (the index is masked)");
+#define D7S_LOG_BATCH 4 //service() writes once this many records are queued...
+#define D7S_LOG_FLUSH_INTERVAL 60000 //...or the oldest queued record waited this long [ms]
+
+//flags of a record
+#define D7S_LOG_SHUTOFF 0x01 //the shutoff event was raised
+#define D7S_LOG_COLLAPSE 0x02 //the collapse event was raised
+#define D7S_LOG_CAPTURE 0x04 //summary of a D7SCapture (peaks and duration from the time history)
+#define D7S_LOG_TRUNCATED 0x08 //the capture was truncated
+
+//earthquake summary stored in the log
+struct D7SLogRecord {
+   uint32_t sequence; //number of the record since the log was created (assigned by append())
+   uint32_t time; //time of the event (unix time if the node has a clock, the queries expect it not to decrease)
+   uint32_t duration; //duration of the event [ms] (0 if unknown)
+   uint16_t si; //peak SI [mm/s]
+   uint16_t pga; //peak PGA [mm/s^2]
+   int16_t temperature; //temperature [0.1 C]
+   uint8_t intensity; //intensity (on the scale of the log)
+   uint8_t flags; //D7S_LOG_* flags
+   uint16_t samples; //samples of the capture (0 if not from a capture)
+};
+
+//storage of the log: a byte range made of erasable sectors
+//writes only go to erased bytes, in increasing order inside a sector
+class D7SLogStorage {
+
+   public:
+
+      virtual ~D7SLogStorage() {}
+
+      virtual uint32_t capacity() = 0; //size of the storage [byte] (multiple of sectorSize())
+      virtual uint32_t sectorSize() = 0; //erase unit [byte] (multiple of D7S_LOG_RECORD_SIZE)
+      virtual bool read(uint32_t offset, uint8_t *data, uint32_t len) = 0;
+      virtual bool write(uint32_t offset, const uint8_t *data, uint32_t len) = 0;
+      virtual bool erase(uint32_t offset) = 0; //erase the sector starting at offset (to 0xFF)
+      virtual bool sync() { return true; } //make the writes durable
+};
+
+#if defined(ESP32)
+
+//storage on a data partition of the flash (add it to the partition table, e.g. "d7slog, data, 0x99, , 64K")
+//NVS is not used: its key-value wear levelling rewrites whole entries, a raw partition takes appends as they are
+class D7SPartitionStorage : public D7SLogStorage {
+
+   public:
+
+      D7SPartitionStorage(const char *label);
+
+      bool begin(); //find the partition, false if it does not exist
+
+      uint32_t capacity();
+      uint32_t sectorSize();
+      bool read(uint32_t offset, uint8_t *data, uint32_t len);
+      bool write(uint32_t offset, const uint8_t *data, uint32_t len);
+      bool erase(uint32_t offset);
+
+   private:
+
+      const char *_label;
+      const esp_partition_t *_partition;
+};
+
+#endif
+
+//append-only event log
+class D7SEventLog {
+
+   public:
+
+      D7SEventLog(D7SLogStorage &storage);
+
+      bool begin(); //scan the storage to find the end of the log, false if the storage is not usable
+      void setScale(uint8_t scale); //scale of the intensity of the summaries (D7S_SCALE_*, PHIVOLCS by default)
+
+      //--- WRITE (any context, never blocks) ---
+      bool append(const D7SLogRecord &record); //queue a record (the sequence is assigned here), false if the queue is full
+      bool appendRecord(const D7SRecord &record, uint32_t time, uint8_t flags = 0); //queue the summary of a d7s record (END_EARTHQUAKE data)
+      bool appendCapture(const D7SCaptureSpan &span, uint32_t time, int16_t temperature = 0, uint8_t flags = 0); //queue the summary of a complete capture
+
+      //--- FLUSH (low priority context) ---
+      uint8_t service(); //write the queue if a batch is ready or the oldest record waited too long, return the records written
+      uint8_t flush(); //write all the queued records now, return the records written
+
+      //--- READ ---
+      uint32_t size(); //record slots in the log, oldest to newest (slots skipped after a torn write included)
+      uint32_t getDropped(); //records lost because the queue was full
+      bool get(uint32_t index, D7SLogRecord &record); //read the index-th record (0 is the oldest), false if it is not valid
+      uint32_t query(uint32_t from, uint32_t to, uint8_t minIntensity, void (*visit)(const D7SLogRecord &record, void *ctx), void *ctx); //visit the records with from <= time <= to and intensity >= minIntensity, oldest first, return how many matched
+
+      //--- CODING ---
+      static void encode(const D7SLogRecord &record, uint8_t *raw); //pack a record in D7S_LOG_RECORD_SIZE bytes
+      static bool decode(const uint8_t *raw, D7SLogRecord &record); //unpack a record, false if it is erased or corrupted
+
+   private:
+
+      uint32_t slotOffset(uint32_t index); //offset of the index-th record (0 is the oldest)
+      bool writeRecords(uint32_t count); //write count queued records at the end of the log
+
+      D7SLogStorage *_storage;
+      uint32_t _slots; //records the storage holds
+      uint32_t _slotsPerSector;
+      uint32_t _first; //slot of the oldest record
+      uint32_t _count; //slots between the oldest record and the end of the log
+      uint32_t _nextSequence;
+      volatile uint32_t _dropped;
+      uint8_t _scale; //D7S_SCALE_*
+
+      //queue (producers: append() under _queueLock, single consumer: flush())
+      #if defined(ESP32)
+         portMUX_TYPE _queueLock;
+      #endif
+      D7SLogRecord _queue[D7S_LOG_QUEUE_SIZE];
+      uint32_t _queueTime[D7S_LOG_QUEUE_SIZE]; //millis() of the append
+      volatile uint8_t _queueHead;
+      volatile uint8_t _queueTail;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "D7SEventStats.h"
+
+#include <string.h>
+
+#include "D7SIntensity.h"
+
+//integer square root
+static uint16_t isqrt(uint64_t value) {
+   uint64_t root = 0;
+   uint64_t bit = (uint64_t) 1 << 62;
+   while (bit > value) {
+      bit >>= 2;
+   }
+   while (bit != 0) {
+      if (value >= root + bit) {
+         value -= root + bit;
+         root = (root >> 1) + bit;
+      } else {
+         root >>= 1;
+      }
+      bit >>= 2;
+   }
+   return root > 0xFFFF ? 0xFFFF : (uint16_t) root;
+}
+
+D7SEventAccumulator::D7SEventAccumulator() {
+   memset(&_stats, 0, sizeof(_stats));
+   _active = 0;
+   _scale = D7S_SCALE_PHIVOLCS;
+   _sumSI = 0;
+   _sumPGA = 0;
+   _lastIntensity = 0;
+   _lastTime = 0;
+   _hasLast = 0;
+}
+
+//the earthquake started (restarts the statistics)
+void D7SEventAccumulator::begin(uint32_t timestamp) {
+   memset(&_stats, 0, sizeof(_stats));
+   _stats.start = timestamp;
+   _stats.end = timestamp;
+   _sumSI = 0;
+   _sumPGA = 0;
+   _hasLast = 0;
+   _active = 1;
+}
+
+//close the time slice of the previous sample at timestamp
+void D7SEventAccumulator::hold(uint32_t timestamp) {
+   if (!_hasLast || (int32_t) (timestamp - _lastTime) <= 0) {
+      return;
+   }
+   uint32_t elapsed = timestamp - _lastTime;
+   for (uint8_t level = 0; level <= _lastIntensity && level < D7S_STATS_LEVELS; level++) {
+      _stats.timeAbove[level] += elapsed;
+   }
+}
+
+//account a sample (ignored unless active)
+void D7SEventAccumulator::add(uint32_t timestamp, uint16_t si, uint16_t pga) {
+   if (!_active) {
+      return;
+   }
+   hold(timestamp);
+
+   _stats.samples++;
+   if (si > _stats.peakSI || _stats.samples == 1) {
+      _stats.peakSI = si;
+      _stats.peakSITime = timestamp;
+   }
+   if (pga > _stats.peakPGA || _stats.samples == 1) {
+      _stats.peakPGA = pga;
+      _stats.peakPGATime = timestamp;
+   }
+   _sumSI += (uint32_t) si * si;
+   _sumPGA += (uint32_t) pga * pga;
+   _stats.rmsSI = isqrt(_sumSI / _stats.samples);
+   _stats.rmsPGA = isqrt(_sumPGA / _stats.samples);
+
+   uint8_t intensity = d7sIntensity(si, pga, _scale);
+   if (intensity > _stats.maxIntensity) {
+      _stats.maxIntensity = intensity;
+   }
+   _lastIntensity = intensity;
+   _lastTime = timestamp;
+   _hasLast = 1;
+
+   _stats.end = timestamp;
+   _stats.duration = timestamp - _stats.start;
+}
+
+//the earthquake ended (ignored unless active)
+void D7SEventAccumulator::end(uint32_t timestamp) {
+   if (!_active) {
+      return;
+   }
+   hold(timestamp);
+   _stats.end = timestamp;
+   _stats.duration = timestamp - _stats.start;
+   _active = 0;
+}
+
+//store the values the d7s recorded for the earthquake
+void D7SEventAccumulator::setRecord(uint16_t si, uint16_t pga, int16_t temperature) {
+   _stats.si = si;
+   _stats.pga = pga;
+   _stats.temperature = temperature;
+   _stats.recordValid = 1;
+}
+
+//scale of the intensity (D7S_SCALE_*), used from the next sample
+void D7SEventAccumulator::setScale(uint8_t scale) {
+   _scale = scale;
+}
+
+//return true between begin() and end()
+uint8_t D7SEventAccumulator::isActive() {
+   return _active;
+}
+
+//statistics of the current (or last) earthquake
+const D7SEventStats &D7SEventAccumulator::getStats() {
+   return _stats;
+}
@@ -0,0 +1,60 @@
+#ifndef D7S_EVENT_STATS_H
+#define D7S_EVENT_STATS_H
+
+#include <stdint.h>
+
+//--- EVENT STATISTICS ---
+#define D7S_STATS_LEVELS 11 //intensity levels tracked by timeAbove (0 - 10 covers every scale)
+
+//statistics of an earthquake, built sample by sample while it is in progress
+struct D7SEventStats {
+   uint32_t start; //millis() of the start of the earthquake
+   uint32_t end; //millis() of the end of the earthquake (equal to start while it is in progress)
+   uint32_t duration; //end - start [ms]
+   uint32_t samples; //samples taken during the earthquake
+   uint16_t peakSI; //highest instantaneous SI [mm/s]
+   uint16_t peakPGA; //highest instantaneous PGA [mm/s^2]
+   uint32_t peakSITime; //millis() of the sample with the highest SI
+   uint32_t peakPGATime; //millis() of the sample with the highest PGA
+   uint16_t rmsSI; //root mean square of the instantaneous SI [mm/s]
+   uint16_t rmsPGA; //root mean square of the instantaneous PGA [mm/s^2]
+   uint8_t maxIntensity; //highest intensity of the samples (on the scale of the accumulator)
+   uint32_t timeAbove[D7S_STATS_LEVELS]; //time spent at or above each intensity level [ms] (each sample holds until the next one)
+   uint8_t recordValid; //true if the values below were read from the d7s at the end of the earthquake
+   uint16_t si; //SI stored by the d7s for the earthquake [mm/s]
+   uint16_t pga; //PGA stored by the d7s for the earthquake [mm/s^2]
+   int16_t temperature; //temperature stored by the d7s for the earthquake [0.1 C]
+};
+
+//accumulator of the statistics of one earthquake at a time (fixed memory, integer only)
+//D7SClass feeds it from acquireSample() and processEvents(), anything replaying samples can feed it the same way
+class D7SEventAccumulator {
+
+   public:
+
+      D7SEventAccumulator();
+
+      void begin(uint32_t timestamp); //the earthquake started (restarts the statistics)
+      void add(uint32_t timestamp, uint16_t si, uint16_t pga); //account a sample (ignored unless active)
+      void end(uint32_t timestamp); //the earthquake ended (ignored unless active)
+      void setRecord(uint16_t si, uint16_t pga, int16_t temperature); //store the values the d7s recorded for the earthquake
+      void setScale(uint8_t scale); //scale of the intensity (D7S_SCALE_*, PHIVOLCS by default)
+      uint8_t isActive(); //return true between begin() and end()
+      const D7SEventStats &getStats(); //statistics of the current (or last) earthquake
+
+   private:
+
+      //close the time slice of the previous sample at timestamp
+      void hold(uint32_t timestamp);
+
+      D7SEventStats _stats;
+      uint8_t _active;
+      uint8_t _scale; //D7S_SCALE_*
+      uint64_t _sumSI; //sum of the squares of the samples
+      uint64_t _sumPGA;
+      uint8_t _lastIntensity; //intensity of the previous sample
+      uint32_t _lastTime; //millis() of the previous sample
+      uint8_t _hasLast; //false until the first sample
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "D7SGroup.h"
+
+D7SGroup::D7SGroup() {
+   _count = 0;
+   #if defined(ESP32)
+      _worker = NULL;
+      _caller = NULL;
+      _pending = NULL;
+      _workerRunning = 0;
+   #endif
+}
+
+D7SGroup::~D7SGroup() {
+   #if defined(ESP32)
+      end();
+   #endif
+}
+
+//add a sensor on bus (0 or 1), false if the group is full
+bool D7SGroup::add(D7SClass &d7s, uint8_t bus) {
+   if (_count >= D7S_GROUP_SIZE || bus >= D7S_GROUP_BUSES) {
+      return false;
+   }
+   //two members on the same transport would read the same d7s (there is one address per bus)
+   for (uint8_t i = 0; i < _count; i++) {
+      if (&_members[i]->getTransport() == &d7s.getTransport()) {
+         return false;
+      }
+   }
+   _members[_count] = &d7s;
+   _buses[_count] = bus;
+   _count++;
+   return true;
+}
+
+//return the number of sensors
+uint8_t D7SGroup::size() {
+   return _count;
+}
+
+#if defined(ESP32)
+
+//start the worker task of the second bus
+bool D7SGroup::begin(uint8_t core, uint8_t priority) {
+   if (_worker != NULL) {
+      return false;
+   }
+   _workerRunning = 1;
+   if (xTaskCreatePinnedToCore(workerTask, "d7s group", D7S_GROUP_WORKER_STACK, this, priority, &_worker, core) != pdPASS) {
+      _workerRunning = 0;
+      _worker = NULL;
+      return false;
+   }
+   return true;
+}
+
+//stop the worker task
+void D7SGroup::end() {
+   if (_worker == NULL) {
+      return;
+   }
+   _workerRunning = 0;
+   xTaskNotifyGive(_worker);
+   //wait for the task to exit
+   while (_worker != NULL) {
+      vTaskDelay(1);
+   }
+}
+
+//body of the worker task: sample the second bus when the caller asks for it
+void D7SGroup::workerTask(void *arg) {
+   D7SGroup *group = (D7SGroup *) arg;
+
+   while (true) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      if (!group->_workerRunning) {
+         break;
+      }
+      group->sampleBus(1, *group->_pending);
+      xTaskNotifyGive(group->_caller);
+   }
+
+   group->_worker = NULL;
+   vTaskDelete(NULL);
+}
+
+#endif
+
+//take one sample from every sensor and vote
+void D7SGroup::sample(D7SGroupSample &result) {
+   uint32_t start = micros();
+   result.count = _count;
+
+   #if defined(ESP32)
+      if (_worker != NULL) {
+         //the worker samples the second bus while this task samples the first one
+         _pending = &result;
+         _caller = xTaskGetCurrentTaskHandle();
+         xTaskNotifyGive(_worker);
+         sampleBus(0, result);
+         //every register access has a deadline, the worker always answers
+         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      } else {
+         sampleBus(0xFF, result);
+      }
+   #else
+      sampleBus(0xFF, result);
+   #endif
+
+   //vote on the valid samples
+   uint16_t si[D7S_GROUP_SIZE];
+   uint16_t pga[D7S_GROUP_SIZE];
+   result.valid = 0;
+   result.earthquakeVotes = 0;
+   for (uint8_t i = 0; i < _count; i++) {
+      const D7SSnapshot &snapshot = result.snapshots[i];
+      if (snapshot.status != D7S_BUS_OK) {
+         continue;
+      }
+      si[result.valid] = snapshot.si;
+      pga[result.valid] = snapshot.pga;
+      result.valid++;
+      if (snapshot.state == NORMAL_MODE_NOT_IN_STANBY) {
+         result.earthquakeVotes++;
+      }
+   }
+   result.si = median(si, result.valid);
+   result.pga = median(pga, result.valid);
+   result.duration = micros() - start;
+}
+
+//sample the sensors of a bus (all of them if bus is 0xFF)
+void D7SGroup::sampleBus(uint8_t bus, D7SGroupSample &result) {
+   if (bus != 0xFF) {
+      for (uint8_t i = 0; i < _count; i++) {
+         if (_buses[i] == bus) {
+            result.snapshots[i] = _members[i]->acquireSample();
+         }
+      }
+      return;
+   }
+   //sequential pass, alternate the buses so the samples of the two buses stay close in time
+   for (uint8_t round = 0; round < _count; round++) {
+      uint8_t taken = 0;
+      for (uint8_t b = 0; b < D7S_GROUP_BUSES; b++) {
+         //the round-th sensor of bus b
+         uint8_t seen = 0;
+         for (uint8_t i = 0; i < _count; i++) {
+            if (_buses[i] == b && seen++ == round) {
+               result.snapshots[i] = _members[i]->acquireSample();
+               taken++;
+               break;
+            }
+         }
+      }
+      if (taken == 0) {
+         break;
+      }
+   }
+}
+
+//median of the first count values (sorted in place, the lower one with an even count)
+//with two sensors it is the smaller value, so a single faulty sensor cannot raise it
+uint16_t D7SGroup::median(uint16_t *values, uint8_t count) {
+   if (count == 0) {
+      return 0;
+   }
+   //insertion sort, the group is small
+   for (uint8_t i = 1; i < count; i++) {
+      uint16_t value = values[i];
+      uint8_t j = i;
+      while (j > 0 && values[j - 1] > value) {
+         values[j] = values[j - 1];
+         j--;
+      }
+      values[j] = value;
+   }
+   return values[(count - 1) / 2];
+}
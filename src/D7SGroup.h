@@ -0,0 +1,68 @@
+#ifndef D7S_GROUP_H
+#define D7S_GROUP_H
+
+#include "D7S.h"
+
+//--- GROUP ---
+#ifndef D7S_GROUP_SIZE
+   #define D7S_GROUP_SIZE 4 //sensors in a group (more than one per bus only behind an I2C mux)
+#endif
+#define D7S_GROUP_BUSES 2 //I2C buses sampled in parallel (ESP32 has two controllers)
+#define D7S_GROUP_WORKER_STACK 3072 //stack of the task sampling the second bus [byte]
+
+//result of a pass over the group
+struct D7SGroupSample {
+   D7SSnapshot snapshots[D7S_GROUP_SIZE]; //one per sensor, in the order of add()
+   uint8_t count; //sensors in the group
+   uint8_t valid; //sensors read successfully
+   uint8_t earthquakeVotes; //valid sensors processing an earthquake (NORMAL_MODE_NOT_IN_STANBY)
+   uint16_t si; //median SI of the valid sensors (the lower one with an even count) [mm/s]
+   uint16_t pga; //median PGA of the valid sensors (the lower one with an even count) [mm/s^2]
+   uint32_t duration; //duration of the pass [us]
+};
+
+//redundant sensors sampled together: every pass takes one sample from each sensor with acquireSample()
+//the sensors on the second bus are sampled by a worker task while the caller samples the first one,
+//so a pass takes as long as the slowest bus instead of the sum of all the sensors (on ESP32, after begin())
+//without the worker the pass is sequential, alternating the buses
+//the group calls acquireSample() itself: do not run the acquisition task of a member (its samples would be rejected)
+//the d7s has a fixed I2C address (0x55): a bus holds one sensor, more sensors on a bus need an I2C mux and one transport per mux channel
+class D7SGroup {
+
+   public:
+
+      D7SGroup();
+      ~D7SGroup();
+
+      bool add(D7SClass &d7s, uint8_t bus = 0); //add a sensor on bus (0 or 1), false if the group is full or its transport is already in the group
+      uint8_t size(); //return the number of sensors
+
+      #if defined(ESP32)
+         bool begin(uint8_t core = 0, uint8_t priority = D7S_ACQUISITION_PRIORITY); //start the worker task of the second bus
+         void end(); //stop the worker task
+      #endif
+
+      void sample(D7SGroupSample &result); //take one sample from every sensor and vote
+
+   private:
+
+      //sample the sensors of a bus (all of them if bus is 0xFF)
+      void sampleBus(uint8_t bus, D7SGroupSample &result);
+      //median of the first count values (sorted in place)
+      static uint16_t median(uint16_t *values, uint8_t count);
+
+      D7SClass *_members[D7S_GROUP_SIZE];
+      uint8_t _buses[D7S_GROUP_SIZE];
+      uint8_t _count;
+
+      #if defined(ESP32)
+         //worker task of the second bus
+         static void workerTask(void *arg);
+         TaskHandle_t _worker;
+         TaskHandle_t _caller; //task waiting for the worker
+         D7SGroupSample *_pending; //result filled by the worker
+         volatile uint8_t _workerRunning;
+      #endif
+};
+
+#endif
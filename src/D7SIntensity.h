@@ -0,0 +1,96 @@
+#ifndef D7S_INTENSITY_H
+#define D7S_INTENSITY_H
+
+#include <stdint.h>
+
+//intensity classification on the raw d7s values (SI [mm/s], PGA [mm/s^2]), integer only: no FPU needed
+//every scale is a table of lower bounds searched with a binary search
+
+//--- SCALES ---
+#define D7S_SCALE_PHIVOLCS 0 //PHIVOLCS Earthquake Intensity Scale from PGA (0 - 10)
+#define D7S_SCALE_JMA 1 //JMA seismic intensity from SI (0 - 9: 0, 1, 2, 3, 4, 5-, 5+, 6-, 6+, 7)
+#define D7S_SCALE_MMI 2 //Modified Mercalli Intensity from PGA and PGV (0 - 10)
+//the scale is chosen at run time (D7SClass::setIntensityScale()), PHIVOLCS is the default everywhere
+
+//JMA levels above 4 are split in lower/upper
+typedef enum d7s_jma_intensity {
+   JMA_0 = 0,
+   JMA_1 = 1,
+   JMA_2 = 2,
+   JMA_3 = 3,
+   JMA_4 = 4,
+   JMA_5_LOWER = 5,
+   JMA_5_UPPER = 6,
+   JMA_6_LOWER = 7,
+   JMA_6_UPPER = 8,
+   JMA_7 = 9
+} d7s_jma_intensity;
+
+//--- TABLES ---
+//PHIVOLCS: lower bound of intensity I..X [mm/s^2] (0.01, 0.02, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5 m/s^2)
+static constexpr uint16_t D7S_PHIVOLCS_PGA[] = {1, 10, 20, 50, 100, 250, 500, 1000, 2500, 5000};
+
+//JMA: lower bound of intensity 1..7 [mm/s], from the instrumental intensity boundaries (0.5, 1.5, ... 6.5)
+//and the empirical relation I = 2.0 * log10(SI [cm/s]) + 2.4
+static constexpr uint16_t D7S_JMA_SI[] = {2, 4, 12, 36, 113, 200, 355, 631, 1123};
+
+//MMI (Wald et al., 1999): lower bound of the II-III, IV, ... X bands
+static constexpr uint16_t D7S_MMI_PGA[] = {17, 137, 382, 902, 1765, 3334, 6374, 12160}; //[mm/s^2] (0.17, 1.4, 3.9, 9.2, 18, 34, 65, 124 %g)
+static constexpr uint16_t D7S_MMI_PGV[] = {1, 11, 34, 81, 160, 310, 600, 1160}; //[mm/s] (0.1, 1.1, 3.4, 8.1, 16, 31, 60, 116 cm/s)
+static constexpr uint8_t D7S_MMI_LEVEL[] = {1, 2, 4, 5, 6, 7, 8, 9, 10}; //MMI of each band (II-III is reported as II)
+
+//--- CLASSIFIERS ---
+//number of lower bounds at or below value (binary search)
+inline uint8_t d7sScaleLevel(const uint16_t *bounds, uint8_t count, uint16_t value) {
+   uint8_t low = 0;
+   uint8_t high = count;
+   while (low < high) {
+      uint8_t mid = (low + high) >> 1;
+      if (bounds[mid] <= value) {
+         low = mid + 1;
+      } else {
+         high = mid;
+      }
+   }
+   return low;
+}
+
+//PHIVOLCS intensity from PGA [mm/s^2]
+inline uint8_t d7sIntensityPHIVOLCS(uint16_t pga) {
+   return d7sScaleLevel(D7S_PHIVOLCS_PGA, sizeof(D7S_PHIVOLCS_PGA) / sizeof(D7S_PHIVOLCS_PGA[0]), pga);
+}
+
+//JMA intensity from SI [mm/s]
+inline uint8_t d7sIntensityJMA(uint16_t si) {
+   return d7sScaleLevel(D7S_JMA_SI, sizeof(D7S_JMA_SI) / sizeof(D7S_JMA_SI[0]), si);
+}
+
+//MMI from PGA [mm/s^2] and PGV [mm/s]: PGA below V, PGV from VII, the average of the two at VI (Wald et al., 1999)
+inline uint8_t d7sIntensityMMI(uint16_t pga, uint16_t pgv) {
+   if (pga == 0 && pgv == 0) {
+      return 0;
+   }
+   uint8_t fromPGA = D7S_MMI_LEVEL[d7sScaleLevel(D7S_MMI_PGA, sizeof(D7S_MMI_PGA) / sizeof(D7S_MMI_PGA[0]), pga)];
+   uint8_t fromPGV = D7S_MMI_LEVEL[d7sScaleLevel(D7S_MMI_PGV, sizeof(D7S_MMI_PGV) / sizeof(D7S_MMI_PGV[0]), pgv)];
+   if (fromPGA <= 5) {
+      return fromPGA;
+   }
+   if (fromPGA >= 7) {
+      return fromPGV;
+   }
+   return (fromPGA + fromPGV + 1) >> 1;
+}
+
+//intensity on scale (D7S_SCALE_*) from SI [mm/s] (used as PGV by MMI) and PGA [mm/s^2]
+inline uint8_t d7sIntensity(uint16_t si, uint16_t pga, uint8_t scale = D7S_SCALE_PHIVOLCS) {
+   switch (scale) {
+      case D7S_SCALE_JMA:
+         return d7sIntensityJMA(si);
+      case D7S_SCALE_MMI:
+         return d7sIntensityMMI(pga, si);
+      default:
+         return d7sIntensityPHIVOLCS(pga);
+   }
+}
+
+#endif
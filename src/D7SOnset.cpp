@@ -0,0 +1,87 @@
+#include "D7SOnset.h"
+
+D7SOnset::D7SOnset(uint16_t staWindow, uint16_t ltaWindow, uint16_t onRatio, uint16_t offRatio, uint16_t minLevel) {
+   configure(staWindow, ltaWindow, onRatio, offRatio, minLevel);
+}
+
+//change the windows [samples], the ratios [x16] and the LTA floor (resets the detector)
+void D7SOnset::configure(uint16_t staWindow, uint16_t ltaWindow, uint16_t onRatio, uint16_t offRatio, uint16_t minLevel) {
+   _staWindow = staWindow ? staWindow : 1;
+   //the long-term window must be longer than the short-term one
+   _ltaWindow = ltaWindow > _staWindow ? ltaWindow : _staWindow + 1;
+   _onRatio = onRatio;
+   //the release must be below the trigger, or the detector would chatter
+   _offRatio = offRatio < onRatio ? offRatio : onRatio;
+   _minLevel = ((uint32_t) (minLevel ? minLevel : 1)) << 8;
+   reset();
+}
+
+//forget the averages (a new warm-up starts)
+void D7SOnset::reset() {
+   _sta = 0;
+   _lta = 0;
+   _ratio = 0;
+   _samples = 0;
+   _triggered = 0;
+}
+
+//feed a sample (PGA [mm/s^2] or SI [mm/s])
+d7s_onset_event D7SOnset::update(uint16_t value) {
+   int32_t x = ((int32_t) value) << 8;
+
+   //the first sample seeds both averages
+   if (_samples == 0) {
+      _sta = x;
+      _lta = x;
+   } else {
+      _sta += (x - (int32_t) _sta) / (int32_t) _staWindow;
+      //the reference does not follow the event
+      if (!_triggered) {
+         _lta += (x - (int32_t) _lta) / (int32_t) _ltaWindow;
+      }
+   }
+   if (_samples < _ltaWindow) {
+      _samples++;
+   }
+
+   //STA/LTA [x16], with the LTA floored and the result saturated
+   uint32_t lta = _lta > _minLevel ? _lta : _minLevel;
+   uint32_t ratio = (_sta << 4) / lta;
+   _ratio = ratio > 0xFFFF ? 0xFFFF : (uint16_t) ratio;
+
+   if (!_triggered) {
+      if (_samples >= _ltaWindow && _ratio >= _onRatio) {
+         _triggered = 1;
+         return D7S_ONSET_ON;
+      }
+   } else if (_ratio <= _offRatio) {
+      _triggered = 0;
+      return D7S_ONSET_OFF;
+   }
+   return D7S_ONSET_NONE;
+}
+
+//return true between D7S_ONSET_ON and D7S_ONSET_OFF
+uint8_t D7SOnset::isTriggered() {
+   return _triggered;
+}
+
+//return true once the LTA covers a whole window
+uint8_t D7SOnset::isWarm() {
+   return _samples >= _ltaWindow;
+}
+
+//short-term average (same unit as the samples)
+uint16_t D7SOnset::getSTA() {
+   return (uint16_t) (_sta >> 8);
+}
+
+//long-term average (same unit as the samples)
+uint16_t D7SOnset::getLTA() {
+   return (uint16_t) (_lta >> 8);
+}
+
+//last STA/LTA [x16]
+uint16_t D7SOnset::getRatio() {
+   return _ratio;
+}
@@ -0,0 +1,57 @@
+#ifndef D7S_ONSET_H
+#define D7S_ONSET_H
+
+#include <stdint.h>
+
+//streaming STA/LTA onset detector on the instantaneous PGA (or SI) samples
+//the short-term and long-term averages are recursive (exponential) averages in Q8 fixed point:
+//O(1) integer work and no memory per sample, whatever the windows
+//the detector triggers when STA/LTA reaches the on ratio and releases when it falls to the off ratio (hysteresis),
+//the LTA is frozen while triggered so the event does not raise its own reference
+
+//--- DEFAULTS (for a sample every 100 ms) ---
+#define D7S_ONSET_STA_WINDOW 3 //short-term window [samples]
+#define D7S_ONSET_LTA_WINDOW 100 //long-term window [samples], also the warm-up before the first trigger
+#define D7S_ONSET_ON_RATIO 64 //STA/LTA that triggers [x16] (4.0)
+#define D7S_ONSET_OFF_RATIO 24 //STA/LTA that releases [x16] (1.5)
+#define D7S_ONSET_MIN_LEVEL 5 //floor of the LTA, so a quiet sensor reading 0 does not trigger on the first count [mm/s^2]
+
+//result of an update
+typedef enum d7s_onset_event {
+   D7S_ONSET_NONE = 0, //nothing changed
+   D7S_ONSET_ON = 1, //the detector triggered on this sample
+   D7S_ONSET_OFF = 2 //the detector released on this sample
+} d7s_onset_event;
+
+class D7SOnset {
+
+   public:
+
+      D7SOnset(uint16_t staWindow = D7S_ONSET_STA_WINDOW, uint16_t ltaWindow = D7S_ONSET_LTA_WINDOW, uint16_t onRatio = D7S_ONSET_ON_RATIO, uint16_t offRatio = D7S_ONSET_OFF_RATIO, uint16_t minLevel = D7S_ONSET_MIN_LEVEL);
+
+      void configure(uint16_t staWindow, uint16_t ltaWindow, uint16_t onRatio, uint16_t offRatio, uint16_t minLevel); //change the windows [samples], the ratios [x16] and the LTA floor (resets the detector)
+      void reset(); //forget the averages (a new warm-up starts)
+
+      d7s_onset_event update(uint16_t value); //feed a sample (PGA [mm/s^2] or SI [mm/s])
+      uint8_t isTriggered(); //return true between D7S_ONSET_ON and D7S_ONSET_OFF
+      uint8_t isWarm(); //return true once the LTA covers a whole window
+      uint16_t getSTA(); //short-term average (same unit as the samples)
+      uint16_t getLTA(); //long-term average (same unit as the samples)
+      uint16_t getRatio(); //last STA/LTA [x16]
+
+   private:
+
+      uint16_t _staWindow;
+      uint16_t _ltaWindow;
+      uint16_t _onRatio;
+      uint16_t _offRatio;
+      uint32_t _minLevel; //[Q8]
+
+      uint32_t _sta; //[Q8]
+      uint32_t _lta; //[Q8]
+      uint16_t _ratio; //[x16]
+      uint16_t _samples; //samples seen, saturated at the LTA window
+      uint8_t _triggered;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef D7S_PLATFORM_H
+#define D7S_PLATFORM_H
+
+//the library uses only a few Arduino functions: on a board they come from the core,
+//on a host build (Linux) they are provided by extras/host/D7SHostPlatform.cpp
+#if defined(ARDUINO)
+
+   #include <Arduino.h>
+
+#else
+
+   #include <stdint.h>
+   #include <stddef.h>
+   #include <string.h>
+
+   //--- PIN LEVELS/MODES ---
+   #define LOW 0x0
+   #define HIGH 0x1
+   #define INPUT_PULLUP 0x2
+   #define RISING 0x01
+   #define FALLING 0x02
+   #define CHANGE 0x03
+
+   //--- TIME ---
+   //the host clock is virtual: it only moves with delay(), delayMicroseconds() and d7sHostAdvance()
+   //so a simulated run is deterministic and can go faster than real time
+   uint32_t millis();
+   uint32_t micros();
+   void delay(uint32_t ms);
+   void delayMicroseconds(uint32_t us);
+   void d7sHostAdvance(uint32_t us); //move the virtual clock forward [us]
+
+   //--- PINS/INTERRUPTS ---
+   void pinMode(uint8_t pin, uint8_t mode);
+   int digitalRead(uint8_t pin);
+   #define digitalPinToInterrupt(pin) (pin)
+   void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+   void attachInterruptArg(uint8_t interrupt, void (*isr)(void *), void *arg, int mode);
+   void detachInterrupt(uint8_t interrupt);
+   void interrupts();
+   void noInterrupts();
+   void d7sHostSetPin(uint8_t pin, uint8_t level); //drive a simulated pin, calling the attached isr on a matching edge
+
+#endif
+
+#endif
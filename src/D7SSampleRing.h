@@ -0,0 +1,106 @@
+#ifndef D7S_SAMPLE_RING_H
+#define D7S_SAMPLE_RING_H
+
+#include <stdint.h>
+#include <string.h>
+
+//--- SAMPLE RING ---
+#ifndef D7S_SAMPLE_RING_SIZE
+   #define D7S_SAMPLE_RING_SIZE 64 //samples kept in the ring (power of two)
+#endif
+static_assert(D7S_SAMPLE_RING_SIZE > 0 && (D7S_SAMPLE_RING_SIZE & (D7S_SAMPLE_RING_SIZE - 1)) == 0, "D7S_SAMPLE_RING_SIZE must be a power of two (the index is masked)");
+
+//position of a consumer in the ring (every consumer keeps its own, consumers never block each other)
+struct D7SSampleCursor {
+   uint32_t next; //sequence number of the next sample to read
+   uint32_t lost; //samples overwritten before this consumer could read them
+};
+
+//preallocated single-producer/multi-consumer ring of samples
+//the producer never waits: every slot is guarded by a sequence number (odd while it is being written),
+//a consumer copies the slot and retries if the sequence changed under it
+template <typename T>
+class D7SSampleRing {
+
+   public:
+
+      //--- CONSTRUCTOR ---
+      D7SSampleRing() {
+         _head = 0;
+         for (uint32_t i = 0; i < D7S_SAMPLE_RING_SIZE; i++) {
+            _slots[i].sequence = 0;
+         }
+      }
+
+      //--- PRODUCER ---
+      //append a sample, overwriting the oldest one when the ring is full
+      void push(const T &sample) {
+         uint32_t index = _head;
+         Slot &slot = _slots[index & (D7S_SAMPLE_RING_SIZE - 1)];
+         //mark the slot as being written
+         slot.sequence = (index << 1) | 1;
+         __sync_synchronize();
+         slot.sample = sample;
+         __sync_synchronize();
+         //publish the slot and the new head
+         slot.sequence = (index + 1) << 1;
+         __sync_synchronize();
+         _head = index + 1;
+      }
+
+      //--- CONSUMER ---
+      //return a cursor positioned on the next sample that will be pushed
+      D7SSampleCursor cursor() const {
+         D7SSampleCursor cursor;
+         cursor.next = _head;
+         cursor.lost = 0;
+         return cursor;
+      }
+
+      //copy the next sample of the cursor, return false if there is no new sample
+      bool read(D7SSampleCursor &cursor, T &sample) const {
+         while (true) {
+            uint32_t head = _head;
+            __sync_synchronize();
+            //nothing new
+            if (cursor.next == head) {
+               return false;
+            }
+            //the producer lapped this consumer, skip to the oldest sample still in the ring
+            if (head - cursor.next > D7S_SAMPLE_RING_SIZE) {
+               cursor.lost += head - cursor.next - D7S_SAMPLE_RING_SIZE;
+               cursor.next = head - D7S_SAMPLE_RING_SIZE;
+            }
+            //copy the slot and check it was not rewritten in the meantime
+            const Slot &slot = _slots[cursor.next & (D7S_SAMPLE_RING_SIZE - 1)];
+            uint32_t expected = (cursor.next + 1) << 1;
+            uint32_t before = slot.sequence;
+            __sync_synchronize();
+            sample = slot.sample;
+            __sync_synchronize();
+            if (before == expected && slot.sequence == expected) {
+               cursor.next++;
+               return true;
+            }
+            //the slot was overwritten while copying, start over with the updated head
+         }
+      }
+
+      //return the number of samples pushed so far
+      uint32_t count() const {
+         return _head;
+      }
+
+   private:
+
+      //slot of the ring
+      struct Slot {
+         volatile uint32_t sequence; //2 * (index + 1) once published, odd while being written
+         T sample;
+      };
+
+      Slot _slots[D7S_SAMPLE_RING_SIZE];
+      volatile uint32_t _head; //sequence number of the next sample to push
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "D7SScheduler.h"
+
+D7SScheduler::D7SScheduler(D7SClass &d7s, uint32_t idlePeriod, uint32_t activePeriod, uint32_t hold) {
+   _d7s = &d7s;
+   _active = 0;
+   _activeUntil = 0;
+   //the first run() samples right away
+   _wake = 1;
+   _scheduled = 1;
+   _next = 0;
+   _lastState = NORMAL_MODE;
+   _samples = 0;
+   #if defined(ESP32)
+      _lightSleep = 0;
+      _pinINT2 = 0;
+   #endif
+   setPeriods(idlePeriod, activePeriod, hold);
+}
+
+//change the sampling periods and the hold time [ms]
+void D7SScheduler::setPeriods(uint32_t idlePeriod, uint32_t activePeriod, uint32_t hold) {
+   _idlePeriod = idlePeriod;
+   _activePeriod = activePeriod ? activePeriod : 1;
+   _hold = hold;
+}
+
+#if defined(ESP32)
+
+//let wait() use light sleep, waking up on the timer or on INT2 going LOW
+void D7SScheduler::enableLightSleep(uint8_t pinINT2) {
+   _pinINT2 = pinINT2;
+   _lightSleep = 1;
+}
+
+#endif
+
+//switch to the active rate for the hold time
+void D7SScheduler::activate(uint32_t now) {
+   _active = 1;
+   _activeUntil = now + _hold;
+}
+
+//process the interrupts and take a sample if it is due, true if snapshot was filled
+bool D7SScheduler::run(D7SSnapshot &snapshot) {
+   uint32_t now = millis();
+
+   //an interrupt (INT2: earthquake start/end, INT1: shutoff/collapse) means activity: sample now
+   if (_d7s->getPendingEvents() > 0) {
+      _d7s->processEvents();
+      _wake = 1;
+   }
+   if (_wake) {
+      activate(now);
+   } else if (!_scheduled || (int32_t) (now - _next) < 0) {
+      return false;
+   }
+   _wake = 0;
+
+   snapshot = _d7s->acquireSample();
+   _samples++;
+
+   //anything but a quiet normal mode, or a change of STATE, keeps the active rate
+   if (snapshot.status == D7S_BUS_OK) {
+      if (snapshot.state != NORMAL_MODE || snapshot.state != _lastState) {
+         activate(now);
+      }
+      _lastState = snapshot.state;
+   }
+   if (_active && (int32_t) (now - _activeUntil) >= 0) {
+      _active = 0;
+   }
+
+   //next sample
+   if (_active) {
+      _next = now + _activePeriod;
+      _scheduled = 1;
+   } else {
+      _next = now + _idlePeriod;
+      _scheduled = _idlePeriod != 0;
+   }
+   return true;
+}
+
+//time until the next sample [ms] (D7S_SCHEDULER_NEVER if none is scheduled)
+uint32_t D7SScheduler::getDelay() {
+   if (_wake || _d7s->getPendingEvents() > 0) {
+      return 0;
+   }
+   if (!_scheduled) {
+      return D7S_SCHEDULER_NEVER;
+   }
+   int32_t delay = (int32_t) (_next - millis());
+   return delay > 0 ? (uint32_t) delay : 0;
+}
+
+//wait (or sleep) until the next sample or an interrupt
+void D7SScheduler::wait() {
+   uint32_t remaining = getDelay();
+   if (remaining == 0) {
+      return;
+   }
+
+   #if defined(ESP32)
+      if (_lightSleep) {
+         //wake up for the next sample
+         if (remaining != D7S_SCHEDULER_NEVER) {
+            esp_sleep_enable_timer_wakeup(((uint64_t) remaining) * 1000);
+         }
+         //while idle INT2 is HIGH, wake up when it goes LOW (during an earthquake it stays LOW, the timer is enough)
+         bool gpio = !_active && digitalRead(_pinINT2) == HIGH;
+         if (gpio) {
+            gpio_wakeup_enable((gpio_num_t) _pinINT2, GPIO_INTR_LOW_LEVEL);
+            esp_sleep_enable_gpio_wakeup();
+         }
+         if (gpio || remaining != D7S_SCHEDULER_NEVER) {
+            esp_light_sleep_start();
+         }
+         if (gpio) {
+            gpio_wakeup_disable((gpio_num_t) _pinINT2);
+         }
+         esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+         //the edge may have happened while the chip was asleep, do not wait for the isr
+         if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+            _wake = 1;
+         }
+         return;
+      }
+   #endif
+
+   //no sleep: wait in small steps so an interrupt is served quickly
+   while (remaining > 0 && _d7s->getPendingEvents() == 0) {
+      uint32_t step = remaining < D7S_SCHEDULER_STEP ? remaining : D7S_SCHEDULER_STEP;
+      delay(step);
+      if (remaining != D7S_SCHEDULER_NEVER) {
+         remaining -= step;
+      }
+   }
+}
+
+//return true while sampling at the active rate
+uint8_t D7SScheduler::isActive() {
+   return _active;
+}
+
+//samples taken so far
+uint32_t D7SScheduler::getSamples() {
+   return _samples;
+}
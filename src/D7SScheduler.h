@@ -0,0 +1,62 @@
+#ifndef D7S_SCHEDULER_H
+#define D7S_SCHEDULER_H
+
+#include "D7S.h"
+
+#if defined(ESP32)
+   #include <esp_sleep.h>
+   #include <driver/gpio.h>
+#endif
+
+//--- SCHEDULER DEFAULTS ---
+#define D7S_SCHEDULER_IDLE_PERIOD 10000 //sampling period while the sensor is idle [ms] (0 = do not sample, wait for INT2)
+#define D7S_SCHEDULER_ACTIVE_PERIOD 100 //sampling period during an earthquake [ms]
+#define D7S_SCHEDULER_HOLD 5000 //time the active rate is kept after the last sign of activity [ms]
+#define D7S_SCHEDULER_STEP 10 //granularity of wait() when it cannot sleep [ms]
+#define D7S_SCHEDULER_NEVER 0xFFFFFFFF //getDelay() when no sample is scheduled
+
+//adaptive sampling: rare samples (or none) while the d7s is idle, the active rate as soon as INT2 fires or STATE changes,
+//back to idle D7S_SCHEDULER_HOLD ms after the earthquake is over
+//loop() calls run() and then wait(), which on ESP32 can put the chip in light sleep until the next sample or INT2
+class D7SScheduler {
+
+   public:
+
+      D7SScheduler(D7SClass &d7s, uint32_t idlePeriod = D7S_SCHEDULER_IDLE_PERIOD, uint32_t activePeriod = D7S_SCHEDULER_ACTIVE_PERIOD, uint32_t hold = D7S_SCHEDULER_HOLD);
+
+      void setPeriods(uint32_t idlePeriod, uint32_t activePeriod, uint32_t hold); //change the sampling periods and the hold time [ms]
+      #if defined(ESP32)
+         void enableLightSleep(uint8_t pinINT2); //let wait() use light sleep, waking up on the timer or on INT2 going LOW
+      #endif
+
+      bool run(D7SSnapshot &snapshot); //process the interrupts and take a sample if it is due, true if snapshot was filled
+      uint32_t getDelay(); //time until the next sample [ms] (D7S_SCHEDULER_NEVER if none is scheduled)
+      void wait(); //wait (or sleep) until the next sample or an interrupt
+      uint8_t isActive(); //return true while sampling at the active rate
+      uint32_t getSamples(); //samples taken so far
+
+   private:
+
+      //switch to the active rate for the hold time
+      void activate(uint32_t now);
+
+      D7SClass *_d7s;
+      uint32_t _idlePeriod;
+      uint32_t _activePeriod;
+      uint32_t _hold;
+
+      uint32_t _next; //millis() of the next sample
+      uint8_t _scheduled; //false if no sample is scheduled (idle without idle period)
+      uint32_t _activeUntil; //millis() when the active rate ends
+      uint8_t _active;
+      uint8_t _wake; //an interrupt or a wakeup asked for a sample right away
+      uint8_t _lastState;
+      uint32_t _samples;
+
+      #if defined(ESP32)
+         uint8_t _lightSleep;
+         uint8_t _pinINT2;
+      #endif
+};
+
+#endif
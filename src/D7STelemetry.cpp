@@ -0,0 +1,247 @@
+#include "D7STelemetry.h"
+
+//--- CODING ---
+
+//write an unsigned varint, return the bytes written (0 if it does not fit)
+static uint8_t writeVarint(uint8_t *out, size_t room, uint32_t value) {
+   uint8_t length = 0;
+   do {
+      if (length >= room) {
+         return 0;
+      }
+      uint8_t byte = value & 0x7F;
+      value >>= 7;
+      out[length++] = value ? byte | 0x80 : byte;
+   } while (value);
+   return length;
+}
+
+//read an unsigned varint, return false if it is truncated or too long
+static bool readVarint(const uint8_t *in, size_t length, size_t &offset, uint32_t &value) {
+   value = 0;
+   for (uint8_t shift = 0; shift < 35; shift += 7) {
+      if (offset >= length) {
+         return false;
+      }
+      uint8_t byte = in[offset++];
+      value |= ((uint32_t) (byte & 0x7F)) << shift;
+      if (!(byte & 0x80)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+//map a signed delta to an unsigned value (0, -1, 1, -2, ... => 0, 1, 2, 3, ...)
+static uint32_t zigzag(int32_t value) {
+   return (((uint32_t) value) << 1) ^ (uint32_t) (value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+   return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+//CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF)
+uint16_t d7sCrc16(const uint8_t *data, size_t length) {
+   uint16_t crc = 0xFFFF;
+   for (size_t i = 0; i < length; i++) {
+      crc ^= ((uint16_t) data[i]) << 8;
+      for (uint8_t bit = 0; bit < 8; bit++) {
+         crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+   }
+   return crc;
+}
+
+//--- ENCODER ---
+
+D7STelemetryEncoder::D7STelemetryEncoder(uint32_t nodeId) {
+   _nodeId = nodeId;
+   reset();
+}
+
+//start a new frame
+void D7STelemetryEncoder::reset() {
+   _length = 0;
+   _frame[_length++] = D7S_TELEMETRY_VERSION;
+   _length += writeVarint(&_frame[_length], sizeof(_frame) - _length, _nodeId);
+   //the count is written by finish()
+   _countOffset = _length++;
+   _count = 0;
+}
+
+//append a sample, false if it does not fit (the frame is left unchanged)
+bool D7STelemetryEncoder::add(const D7STelemetrySample &sample) {
+   //the frame must keep room for the CRC, and the count is one byte
+   if (_count == 0xFF) {
+      return false;
+   }
+   size_t room = sizeof(_frame) - 2;
+   uint8_t length = _length;
+   uint8_t written;
+
+   if (_count == 0) {
+      //the first sample carries sequence and timestamp in full
+      written = writeVarint(&_frame[length], room - length, sample.sequence);
+      if (!written) {
+         return false;
+      }
+      length += written;
+      written = writeVarint(&_frame[length], room - length, sample.timestamp);
+      if (!written || length + written >= room) {
+         return false;
+      }
+      length += written;
+      _previous.si = 0;
+      _previous.pga = 0;
+   }
+
+   //flags
+   bool gap = _count > 0 && sample.sequence != _previous.sequence + 1;
+   if (length >= room) {
+      return false;
+   }
+   _frame[length++] = (gap ? 0x80 : 0x00) | ((sample.state & 0x07) << 4) | (sample.intensity & 0x0F);
+
+   //gap and time delta (only after the first sample)
+   if (_count > 0) {
+      if (gap) {
+         written = writeVarint(&_frame[length], room - length, sample.sequence - _previous.sequence - 1);
+         if (!written) {
+            return false;
+         }
+         length += written;
+      }
+      written = writeVarint(&_frame[length], room - length, sample.timestamp - _previous.timestamp);
+      if (!written) {
+         return false;
+      }
+      length += written;
+   }
+
+   //deltas of SI and PGA
+   written = writeVarint(&_frame[length], room - length, zigzag((int32_t) sample.si - (int32_t) _previous.si));
+   if (!written) {
+      return false;
+   }
+   length += written;
+   written = writeVarint(&_frame[length], room - length, zigzag((int32_t) sample.pga - (int32_t) _previous.pga));
+   if (!written) {
+      return false;
+   }
+   length += written;
+
+   //commit
+   _length = length;
+   _count++;
+   _previous = sample;
+   return true;
+}
+
+//samples in the frame
+uint8_t D7STelemetryEncoder::count() {
+   return _count;
+}
+
+//close the frame (count and CRC) and return it
+const uint8_t *D7STelemetryEncoder::finish(uint8_t &length) {
+   _frame[_countOffset] = _count;
+   uint16_t crc = d7sCrc16(_frame, _length);
+   _frame[_length] = crc >> 8;
+   _frame[_length + 1] = crc & 0xFF;
+   length = _length + 2;
+   return _frame;
+}
+
+//--- DECODER ---
+
+D7STelemetryDecoder::D7STelemetryDecoder() {
+   _frame = NULL;
+   _length = 0;
+   _offset = 0;
+   _nodeId = 0;
+   _count = 0;
+   _read = 0;
+}
+
+//check version and CRC and read the header, false if the frame is not valid
+bool D7STelemetryDecoder::begin(const uint8_t *frame, size_t length) {
+   _frame = frame;
+   _count = 0;
+   _read = 0;
+
+   //version, node id, count and CRC at least
+   if (length < 5 || frame[0] != D7S_TELEMETRY_VERSION) {
+      return false;
+   }
+   _length = length - 2;
+   if (d7sCrc16(frame, _length) != ((frame[_length] << 8) | frame[_length + 1])) {
+      return false;
+   }
+
+   _offset = 1;
+   if (!readVarint(_frame, _length, _offset, _nodeId) || _offset >= _length) {
+      return false;
+   }
+   _count = _frame[_offset++];
+   if (_count == 0) {
+      return true;
+   }
+
+   //first sequence and timestamp
+   if (!readVarint(_frame, _length, _offset, _previous.sequence) || !readVarint(_frame, _length, _offset, _previous.timestamp)) {
+      _count = 0;
+      return false;
+   }
+   _previous.si = 0;
+   _previous.pga = 0;
+   return true;
+}
+
+//node that sent the frame
+uint32_t D7STelemetryDecoder::nodeId() {
+   return _nodeId;
+}
+
+//samples in the frame
+uint8_t D7STelemetryDecoder::count() {
+   return _count;
+}
+
+//read the next sample, false at the end of the frame or if it is malformed
+bool D7STelemetryDecoder::next(D7STelemetrySample &sample) {
+   if (_read >= _count || _offset >= _length) {
+      return false;
+   }
+
+   uint8_t flags = _frame[_offset++];
+   sample.state = (flags >> 4) & 0x07;
+   sample.intensity = flags & 0x0F;
+   sample.sequence = _previous.sequence;
+   sample.timestamp = _previous.timestamp;
+
+   //gap and time delta (only after the first sample)
+   if (_read > 0) {
+      uint32_t gap = 0, dt;
+      if ((flags & 0x80) && !readVarint(_frame, _length, _offset, gap)) {
+         return false;
+      }
+      if (!readVarint(_frame, _length, _offset, dt)) {
+         return false;
+      }
+      sample.sequence += gap + 1;
+      sample.timestamp += dt;
+   }
+
+   //deltas of SI and PGA
+   uint32_t si, pga;
+   if (!readVarint(_frame, _length, _offset, si) || !readVarint(_frame, _length, _offset, pga)) {
+      return false;
+   }
+   sample.si = (uint16_t) ((int32_t) _previous.si + unzigzag(si));
+   sample.pga = (uint16_t) ((int32_t) _previous.pga + unzigzag(pga));
+
+   _previous = sample;
+   _read++;
+   return true;
+}
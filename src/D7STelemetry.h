@@ -0,0 +1,88 @@
+#ifndef D7S_TELEMETRY_H
+#define D7S_TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//compact binary frames carrying a batch of samples from a node (e.g. one LoRa packet)
+//plain C++ without Arduino dependencies: the same code encodes on the node and decodes on a Linux gateway
+//
+//frame layout (varint = unsigned LEB128, zigzag = signed delta as varint):
+//   version         1 byte (D7S_TELEMETRY_VERSION)
+//   node id         varint
+//   count           1 byte (samples in the frame)
+//   first sequence  varint
+//   first timestamp varint [ms]
+//   samples         count times:
+//      flags        1 byte: bit 7 = sequence gap, bits 6-4 = state, bits 3-0 = intensity
+//      gap          varint, only with the gap flag: sequence - previous sequence - 1 (not for the first sample)
+//      dt           varint, timestamp - previous timestamp [ms] (not for the first sample)
+//      si           zigzag, si - previous si (the first sample starts from 0) [mm/s]
+//      pga          zigzag, pga - previous pga (the first sample starts from 0) [mm/s^2]
+//   crc             2 byte, CRC-16/CCITT-FALSE of everything before it (msb first)
+
+//--- FRAME ---
+#define D7S_TELEMETRY_VERSION 0x01
+#ifndef D7S_TELEMETRY_MAX_FRAME
+   #define D7S_TELEMETRY_MAX_FRAME 64 //bytes of a frame, CRC included (keep it within the radio payload)
+#endif
+
+//sample carried by the frames
+struct D7STelemetrySample {
+   uint32_t sequence; //sample number on the node (a gap means samples were not sent)
+   uint32_t timestamp; //millis() of the node
+   uint8_t state; //d7s_status (0 - 7)
+   uint8_t intensity; //intensity level (0 - 15)
+   uint16_t si; //instantaneous SI [mm/s]
+   uint16_t pga; //instantaneous PGA [mm/s^2]
+};
+
+//builds a frame sample by sample
+class D7STelemetryEncoder {
+
+   public:
+
+      D7STelemetryEncoder(uint32_t nodeId);
+
+      void reset(); //start a new frame
+      bool add(const D7STelemetrySample &sample); //append a sample, false if it does not fit (the frame is left unchanged)
+      uint8_t count(); //samples in the frame
+      const uint8_t *finish(uint8_t &length); //close the frame (count and CRC) and return it, call reset() before reusing the encoder
+
+   private:
+
+      uint32_t _nodeId;
+      uint8_t _frame[D7S_TELEMETRY_MAX_FRAME];
+      uint8_t _length;
+      uint8_t _countOffset;
+      uint8_t _count;
+      D7STelemetrySample _previous;
+};
+
+//reads the samples of a frame
+class D7STelemetryDecoder {
+
+   public:
+
+      D7STelemetryDecoder();
+
+      bool begin(const uint8_t *frame, size_t length); //check version and CRC and read the header, false if the frame is not valid
+      uint32_t nodeId(); //node that sent the frame
+      uint8_t count(); //samples in the frame
+      bool next(D7STelemetrySample &sample); //read the next sample, false at the end of the frame or if it is malformed
+
+   private:
+
+      const uint8_t *_frame;
+      size_t _length; //without the CRC
+      size_t _offset;
+      uint32_t _nodeId;
+      uint8_t _count;
+      uint8_t _read;
+      D7STelemetrySample _previous;
+};
+
+//CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF)
+uint16_t d7sCrc16(const uint8_t *data, size_t length);
+
+#endif
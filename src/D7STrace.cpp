@@ -0,0 +1,105 @@
+#include "D7STrace.h"
+
+#include <stdio.h>
+
+#if defined(D7S_TRACE)
+   D7STrace d7sTrace;
+#endif
+
+D7STrace::D7STrace() {
+   clear();
+}
+
+//drop every record
+void D7STrace::clear() {
+   _head = 0;
+}
+
+//records written since the last clear() (the ring keeps the last D7S_TRACE_SIZE)
+uint32_t D7STrace::count() {
+   return _head;
+}
+
+//copy the records still in the ring, oldest first, return how many
+uint16_t D7STrace::read(D7STraceRecord *records, uint16_t max) {
+   uint32_t head = _head;
+   uint32_t available = head < D7S_TRACE_SIZE ? head : D7S_TRACE_SIZE;
+   if (available > max) {
+      available = max;
+   }
+   for (uint32_t i = 0; i < available; i++) {
+      records[i] = _records[(head - available + i) & (D7S_TRACE_SIZE - 1)];
+   }
+   return (uint16_t) available;
+}
+
+//write the header, one line per record and an end line
+//header: D7ST <version> <records written> <records in the dump>
+void D7STrace::dump(d7s_trace_writer writer, void *ctx) {
+   static const char digits[] = "0123456789abcdef";
+   uint32_t head = _head;
+   uint32_t available = head < D7S_TRACE_SIZE ? head : D7S_TRACE_SIZE;
+   char line[2 * D7S_TRACE_RECORD_SIZE + 1];
+
+   snprintf(line, sizeof(line), "D7ST %u %lu %lu", D7S_TRACE_VERSION, (unsigned long) head, (unsigned long) available);
+   writer(line, ctx);
+   for (uint32_t i = 0; i < available; i++) {
+      uint8_t data[D7S_TRACE_RECORD_SIZE];
+      encode(_records[(head - available + i) & (D7S_TRACE_SIZE - 1)], data);
+      for (uint8_t j = 0; j < D7S_TRACE_RECORD_SIZE; j++) {
+         line[2 * j] = digits[data[j] >> 4];
+         line[2 * j + 1] = digits[data[j] & 0x0F];
+      }
+      line[2 * D7S_TRACE_RECORD_SIZE] = '\0';
+      writer(line, ctx);
+   }
+   writer("END", ctx);
+}
+
+#if defined(ARDUINO)
+
+//line writer of dump(Print &)
+static void printLine(const char *line, void *ctx) {
+   ((Print *) ctx)->println(line);
+}
+
+//dump to a serial port (or any Print)
+void D7STrace::dump(Print &out) {
+   dump(printLine, &out);
+}
+
+#endif
+
+//pack a record in D7S_TRACE_RECORD_SIZE bytes (little endian)
+void D7STrace::encode(const D7STraceRecord &record, uint8_t *data) {
+   data[0] = record.timestamp;
+   data[1] = record.timestamp >> 8;
+   data[2] = record.timestamp >> 16;
+   data[3] = record.timestamp >> 24;
+   data[4] = record.reg;
+   data[5] = record.reg >> 8;
+   data[6] = record.value;
+   data[7] = record.value >> 8;
+   data[8] = record.duration;
+   data[9] = record.duration >> 8;
+   data[10] = record.op;
+   data[11] = record.status;
+   data[12] = record.length;
+   data[13] = record.attempts;
+   data[14] = record.instance;
+   data[15] = record.api;
+}
+
+//unpack a record
+void D7STrace::decode(const uint8_t *data, D7STraceRecord &record) {
+   record.timestamp = (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+   record.reg = data[4] | (data[5] << 8);
+   record.value = data[6] | (data[7] << 8);
+   record.duration = data[8] | (data[9] << 8);
+   record.op = data[10];
+   record.status = data[11];
+   record.length = data[12];
+   record.attempts = data[13];
+   record.instance = data[14];
+   record.api = data[15];
+}
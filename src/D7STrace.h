@@ -0,0 +1,98 @@
+#ifndef D7S_TRACE_H
+#define D7S_TRACE_H
+
+#include "D7SPlatform.h"
+
+//--- TRACE ---
+//uncomment this line (or build with -DD7S_TRACE) to record every register access and interrupt edge in a RAM ring
+//(DEBUG, which used to print them on Serial, enables it too)
+//#define D7S_TRACE
+#if defined(DEBUG) && !defined(D7S_TRACE)
+   #define D7S_TRACE
+#endif
+
+#ifndef D7S_TRACE_SIZE
+   #define D7S_TRACE_SIZE 256 //records kept in the ring (power of two, 16 byte each)
+#endif
+static_assert(D7S_TRACE_SIZE > 0 && (D7S_TRACE_SIZE & (D7S_TRACE_SIZE - 1)) == 0, "D7S_TRACE_SIZE must be a power of two (the index is masked)");
+#define D7S_TRACE_RECORD_SIZE 16 //bytes of an encoded record
+#define D7S_TRACE_VERSION 1 //version of the dump format
+
+//what a record describes
+typedef enum d7s_trace_op {
+   D7S_TRACE_READ = 0, //register read (value: first bytes read, msb first)
+   D7S_TRACE_WRITE = 1, //register write (value: byte written)
+   D7S_TRACE_INT1 = 2, //INT1 edge seen by the isr (value: pin level)
+   D7S_TRACE_INT2 = 3 //INT2 edge seen by the isr (value: pin level)
+} d7s_trace_op;
+
+//record of the trace
+struct D7STraceRecord {
+   uint32_t timestamp; //micros() at the start of the access or at the edge
+   uint16_t reg; //register address (0 for the edges)
+   uint16_t value; //first two bytes read, the byte written or the pin level
+   uint16_t duration; //duration of the access, retries included (saturated) [us]
+   uint8_t op; //d7s_trace_op
+   uint8_t status; //d7s_bus_status
+   uint8_t length; //bytes read or written
+   uint8_t attempts; //attempts made (1 = no retry)
+   uint8_t instance; //D7SClass instance that made the access
+   uint8_t api; //d7s_api of the public method being executed
+};
+
+//line of a text dump
+typedef void (*d7s_trace_writer)(const char *line, void *ctx);
+
+//ring of binary trace records
+//record() is a handful of stores: no formatting, no I/O, safe in an isr, so tracing does not change the bus timing
+//the dump is text (one hex-encoded record per line) so it survives a serial monitor,
+//extras/host/examples/d7s_trace_decode.cpp turns it into a timeline
+class D7STrace {
+
+   public:
+
+      D7STrace();
+
+      //append a record, overwriting the oldest one when the ring is full
+      inline void record(uint8_t op, uint8_t instance, uint16_t reg, uint16_t value, uint8_t length, uint8_t status, uint32_t timestamp, uint32_t duration, uint8_t attempts, uint8_t api) {
+         uint32_t index = __sync_fetch_and_add(&_head, 1);
+         D7STraceRecord &record = _records[index & (D7S_TRACE_SIZE - 1)];
+         record.timestamp = timestamp;
+         record.reg = reg;
+         record.value = value;
+         record.duration = duration > 0xFFFF ? 0xFFFF : (uint16_t) duration;
+         record.op = op;
+         record.status = status;
+         record.length = length;
+         record.attempts = attempts;
+         record.instance = instance;
+         record.api = api;
+      }
+
+      void clear(); //drop every record
+      uint32_t count(); //records written since the last clear() (the ring keeps the last D7S_TRACE_SIZE)
+      uint16_t read(D7STraceRecord *records, uint16_t max); //copy the records still in the ring, oldest first, return how many
+      void dump(d7s_trace_writer writer, void *ctx); //write the header, one line per record and an end line
+      #if defined(ARDUINO)
+         void dump(Print &out); //dump to a serial port (or any Print)
+      #endif
+
+      //--- ENCODING ---
+      static void encode(const D7STraceRecord &record, uint8_t *data); //pack a record in D7S_TRACE_RECORD_SIZE bytes (little endian)
+      static void decode(const uint8_t *data, D7STraceRecord &record); //unpack a record
+
+   private:
+
+      D7STraceRecord _records[D7S_TRACE_SIZE];
+      volatile uint32_t _head; //records written
+};
+
+#if defined(D7S_TRACE)
+   //trace shared by every D7SClass instance (one timeline for the whole bus)
+   extern D7STrace d7sTrace;
+   #define D7S_TRACE_RECORD(...) d7sTrace.record(__VA_ARGS__)
+#else
+   #define D7S_TRACE_RECORD(...)
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef D7S_TRANSPORT_H
+#define D7S_TRANSPORT_H
+
+#include "D7SPlatform.h"
+#include "D7SBusLock.h"
+
+#if defined(ARDUINO)
+   #include <Wire.h>
+#endif
+
+//bus used by D7SClass to talk with the sensor
+//the status codes are the ones of Wire.endTransmission() (0 = success, 2 = NACK on address, 3 = NACK on data, 5 = timeout)
+class D7STransport {
+
+   public:
+
+      virtual ~D7STransport() {}
+
+      virtual void begin() = 0; //initialize the bus
+      virtual void setClock(uint32_t clock) = 0; //change the bus clock [Hz]
+      virtual void setTimeout(uint16_t timeout) = 0; //bound the time spent on a single transfer [ms]
+      virtual uint8_t write(uint8_t address, const uint8_t *data, uint8_t len, bool stop) = 0; //write len bytes, return the status
+      virtual uint8_t read(uint8_t address, uint8_t *data, uint8_t len) = 0; //read up to len bytes, return the number of bytes received
+
+      D7SBusLock &getLock() { return _lock; } //ownership of the bus, to be taken by everything talking through this transport
+
+   private:
+
+      D7SBusLock _lock;
+};
+
+#if defined(ARDUINO)
+
+//transport over an Arduino TwoWire instance (default transport of the library)
+class D7SWireTransport : public D7STransport {
+
+   public:
+
+      D7SWireTransport() : _wire(NULL), _sda(-1), _scl(-1) {}
+      D7SWireTransport(TwoWire &wire, int sda = -1, int scl = -1) : _wire(&wire), _sda(sda), _scl(scl) {}
+
+      void attach(TwoWire &wire, int sda = -1, int scl = -1) { //bind a default constructed transport to wire
+         _wire = &wire;
+         _sda = sda;
+         _scl = scl;
+      }
+      TwoWire *getWire() { return _wire; } //wire of the transport (NULL until attached)
+
+      void begin() {
+         #if defined(ESP32)
+            //ESP32 can route each controller to any pin
+            if (_sda >= 0 && _scl >= 0) {
+               _wire->begin(_sda, _scl);
+               return;
+            }
+         #endif
+         _wire->begin();
+      }
+
+      void setClock(uint32_t clock) {
+         _wire->setClock(clock);
+      }
+
+      void setTimeout(uint16_t timeout) {
+         #if defined(ESP32)
+            _wire->setTimeOut(timeout);
+         #else
+            (void) timeout;
+         #endif
+      }
+
+      uint8_t write(uint8_t address, const uint8_t *data, uint8_t len, bool stop) {
+         //the bytes are only buffered, nothing goes on the bus until endTransmission
+         _wire->beginTransmission(address);
+         _wire->write(data, len);
+         return _wire->endTransmission(stop);
+      }
+
+      uint8_t read(uint8_t address, uint8_t *data, uint8_t len) {
+         //requestFrom returns once the read is complete, the d7s stretches SCL while it prepares the data
+         uint8_t received = _wire->requestFrom(address, len);
+         for (uint8_t i = 0; i < received && i < len; i++) {
+            data[i] = _wire->read();
+         }
+         return received;
+      }
+
+   private:
+
+      TwoWire *_wire;
+      int _sda; //-1 = default pin
+      int _scl; //-1 = default pin
+};
+
+#endif
+
+#endif